@@ -0,0 +1,80 @@
+#ifdef AES_BENCH
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "aes.h"
+#include "aes_ni.h"
+#include "gj_aes.h"
+
+/*
+ * cbc decrypt throughput: the old 16 byte table path against gj_aes with
+ * aes-ni (when the cpu has it) on one thread and on all cpus
+ * usage: gjaesbench [MB] [threads]
+ */
+
+static double nowms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1000.0+ts.tv_nsec/1000000.0;
+}
+
+static void report(const char* name,size_t size,double ms,int same){
+    printf("%-24s %8.1f ms %8.1f MB/s %s\n",name,ms,size/1048576.0/(ms/1000.0),same?"ok":"MISMATCH");
+}
+
+int main(int argc,char** argv){
+    size_t mb = argc>1?atoi(argv[1]):256;
+    int threads = argc>2?atoi(argv[2]):0;
+    size_t size = mb*1024*1024;
+    char key[] = "yymrjzbwyrbjszrk";
+    char aiv[] = "yymrjzbwyrbjszrk";
+    char* plain = (char*)malloc(size);
+    char* cipher = (char*)malloc(size);
+    char* out = (char*)malloc(size);
+    if(!plain||!cipher||!out)return -1;
+    size_t k;
+    for(k=0;k<size;k++)plain[k] = (char)(k*131+7);
+    printf("size %zu MB aes-ni %d\n",mb,aesni_supported());
+
+    gj_aesc_t* aesc = NULL;
+    int outlen = 0;
+    init_aesc(key,aiv,1,&aesc);
+    double t0 = nowms();
+    do_aesc(aesc,plain,size,cipher,&outlen);
+    report("encrypt gj_aes",size,nowms()-t0,1);
+    free_aesc(&aesc);
+
+    //what mainenc used to do: AES_cbc_encrypt 16 bytes per call
+    AES_KEY aeskey;
+    unsigned char iv[16];
+    AES_set_decrypt_key((const unsigned char*)key,128,&aeskey);
+    memcpy(iv,aiv,16);
+    memset(out,0,size);
+    t0 = nowms();
+    for(k=0;k<size;k+=16){
+        AES_cbc_encrypt((const unsigned char*)cipher+k,(unsigned char*)out+k,16,&aeskey,iv,AES_DECRYPT);
+    }
+    report("decrypt table 16B",size,nowms()-t0,!memcmp(out,plain,size));
+
+    init_aesc(key,aiv,0,&aesc);
+    memset(out,0,size);
+    t0 = nowms();
+    do_aesc_mt(aesc,cipher,size,out,1);
+    report("decrypt gj_aes 1 thread",size,nowms()-t0,!memcmp(out,plain,size));
+    free_aesc(&aesc);
+
+    init_aesc(key,aiv,0,&aesc);
+    memset(out,0,size);
+    t0 = nowms();
+    do_aesc_mt(aesc,cipher,size,out,threads);
+    report("decrypt gj_aes mt",size,nowms()-t0,!memcmp(out,plain,size));
+    free_aesc(&aesc);
+
+    free(plain);
+    free(cipher);
+    free(out);
+    return 0;
+}
+#endif
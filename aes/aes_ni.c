@@ -0,0 +1,140 @@
+#include "aes_ni.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <wmmintrin.h>
+#include <emmintrin.h>
+
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+
+int aesni_supported(void){
+    static int support = -1;
+    if(support<0){
+        __builtin_cpu_init();
+        support = __builtin_cpu_supports("aes")?1:0;
+    }
+    return support;
+}
+
+AESNI_TARGET static __m128i expand128(__m128i key,__m128i gen){
+    gen = _mm_shuffle_epi32(gen,0xff);
+    key = _mm_xor_si128(key,_mm_slli_si128(key,4));
+    key = _mm_xor_si128(key,_mm_slli_si128(key,4));
+    key = _mm_xor_si128(key,_mm_slli_si128(key,4));
+    return _mm_xor_si128(key,gen);
+}
+
+#define EXPAND128(rk,i,rcon) rk[i] = expand128(rk[i-1],_mm_aeskeygenassist_si128(rk[i-1],rcon))
+
+AESNI_TARGET void aesni_set_key128(const unsigned char *key, unsigned char *enckey,
+                                   unsigned char *deckey){
+    __m128i rk[11];
+    int k;
+    rk[0] = _mm_loadu_si128((const __m128i*)key);
+    EXPAND128(rk,1,0x01);
+    EXPAND128(rk,2,0x02);
+    EXPAND128(rk,3,0x04);
+    EXPAND128(rk,4,0x08);
+    EXPAND128(rk,5,0x10);
+    EXPAND128(rk,6,0x20);
+    EXPAND128(rk,7,0x40);
+    EXPAND128(rk,8,0x80);
+    EXPAND128(rk,9,0x1b);
+    EXPAND128(rk,10,0x36);
+    for(k=0;k<11;k++){
+        if(enckey)_mm_storeu_si128((__m128i*)(enckey+16*k),rk[k]);
+    }
+    if(!deckey)return;
+    //equivalent inverse cipher: reversed order, InvMixColumns on the inner keys
+    _mm_storeu_si128((__m128i*)deckey,rk[10]);
+    for(k=1;k<10;k++){
+        _mm_storeu_si128((__m128i*)(deckey+16*k),_mm_aesimc_si128(rk[10-k]));
+    }
+    _mm_storeu_si128((__m128i*)(deckey+160),rk[0]);
+}
+
+AESNI_TARGET void aesni_cbc_encrypt(const unsigned char *in, unsigned char *out,
+                                    size_t blocks, const unsigned char *enckey,
+                                    unsigned char *ivec){
+    __m128i rk[11];
+    int k;
+    for(k=0;k<11;k++)rk[k] = _mm_loadu_si128((const __m128i*)(enckey+16*k));
+    __m128i fb = _mm_loadu_si128((const __m128i*)ivec);
+    size_t i;
+    for(i=0;i<blocks;i++){
+        fb = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in+16*i)),fb);
+        fb = _mm_xor_si128(fb,rk[0]);
+        for(k=1;k<10;k++)fb = _mm_aesenc_si128(fb,rk[k]);
+        fb = _mm_aesenclast_si128(fb,rk[10]);
+        _mm_storeu_si128((__m128i*)(out+16*i),fb);
+    }
+    _mm_storeu_si128((__m128i*)ivec,fb);
+}
+
+AESNI_TARGET void aesni_cbc_decrypt(const unsigned char *in, unsigned char *out,
+                                    size_t blocks, const unsigned char *deckey,
+                                    unsigned char *ivec){
+    __m128i rk[11];
+    int k;
+    for(k=0;k<11;k++)rk[k] = _mm_loadu_si128((const __m128i*)(deckey+16*k));
+    __m128i prev = _mm_loadu_si128((const __m128i*)ivec);
+    size_t i = 0;
+    //blocks are independent when decrypting, keep four in flight
+    for(;i+4<=blocks;i+=4){
+        const __m128i* src = (const __m128i*)(in+16*i);
+        __m128i c0 = _mm_loadu_si128(src);
+        __m128i c1 = _mm_loadu_si128(src+1);
+        __m128i c2 = _mm_loadu_si128(src+2);
+        __m128i c3 = _mm_loadu_si128(src+3);
+        __m128i b0 = _mm_xor_si128(c0,rk[0]);
+        __m128i b1 = _mm_xor_si128(c1,rk[0]);
+        __m128i b2 = _mm_xor_si128(c2,rk[0]);
+        __m128i b3 = _mm_xor_si128(c3,rk[0]);
+        for(k=1;k<10;k++){
+            b0 = _mm_aesdec_si128(b0,rk[k]);
+            b1 = _mm_aesdec_si128(b1,rk[k]);
+            b2 = _mm_aesdec_si128(b2,rk[k]);
+            b3 = _mm_aesdec_si128(b3,rk[k]);
+        }
+        b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0,rk[10]),prev);
+        b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1,rk[10]),c0);
+        b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2,rk[10]),c1);
+        b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3,rk[10]),c2);
+        prev = c3;
+        __m128i* dst = (__m128i*)(out+16*i);
+        _mm_storeu_si128(dst,b0);
+        _mm_storeu_si128(dst+1,b1);
+        _mm_storeu_si128(dst+2,b2);
+        _mm_storeu_si128(dst+3,b3);
+    }
+    for(;i<blocks;i++){
+        __m128i c = _mm_loadu_si128((const __m128i*)(in+16*i));
+        __m128i b = _mm_xor_si128(c,rk[0]);
+        for(k=1;k<10;k++)b = _mm_aesdec_si128(b,rk[k]);
+        b = _mm_xor_si128(_mm_aesdeclast_si128(b,rk[10]),prev);
+        prev = c;
+        _mm_storeu_si128((__m128i*)(out+16*i),b);
+    }
+    _mm_storeu_si128((__m128i*)ivec,prev);
+}
+
+#else
+
+int aesni_supported(void){
+    return 0;
+}
+
+void aesni_set_key128(const unsigned char *key, unsigned char *enckey,
+                      unsigned char *deckey){
+}
+
+void aesni_cbc_encrypt(const unsigned char *in, unsigned char *out,
+                       size_t blocks, const unsigned char *enckey,
+                       unsigned char *ivec){
+}
+
+void aesni_cbc_decrypt(const unsigned char *in, unsigned char *out,
+                       size_t blocks, const unsigned char *deckey,
+                       unsigned char *ivec){
+}
+
+#endif
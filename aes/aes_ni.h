@@ -0,0 +1,29 @@
+#ifndef HEADER_AES_NI_H
+# define HEADER_AES_NI_H
+
+# include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * AES-128 CBC on the x86 AES instructions, picked at run time by gj_aes.
+ * key schedules are 11 round keys of 16 bytes, in and out may be the same
+ * buffer, iv is updated like AES_cbc_encrypt does.
+ */
+int  aesni_supported(void);
+void aesni_set_key128(const unsigned char *key, unsigned char *enckey,
+                      unsigned char *deckey);
+void aesni_cbc_encrypt(const unsigned char *in, unsigned char *out,
+                       size_t blocks, const unsigned char *enckey,
+                       unsigned char *ivec);
+void aesni_cbc_decrypt(const unsigned char *in, unsigned char *out,
+                       size_t blocks, const unsigned char *deckey,
+                       unsigned char *ivec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,18 +5,22 @@
 #include "gj_aes.h"
 #include "aesmain.h"
 
+//bytes read and ciphered per call, a multiple of 16
+#define GJ_AES_CHUNK    (4*1024*1024)
+
 int mainenc(int enc,char* infn,char* outfn){
     char result[255] ;
     memset(result,0,255);
     char* key = "yymrjzbwyrbjszrk";
     char* aiv = "yymrjzbwyrbjszrk";
     int base64 = 1;
-    int outlen = 0;
     int encrst = 0;
     char* fn1 = infn;
     char* fn2 = outfn;
     FILE* fr = fopen(fn1,"rb");
     FILE* fw = fopen(fn2,"wb");
+    gj_aesc_t* aesc = NULL;
+    char* data = NULL;
     while(1){
         if(!fr){
             encrst = -1001;
@@ -26,7 +30,11 @@ int mainenc(int enc,char* infn,char* outfn){
             encrst = -1002;
             break;
         }
-        gj_aesc_t* aesc = NULL;
+        data = (char*)malloc(GJ_AES_CHUNK);
+        if(!data){
+            encrst = -1006;
+            break;
+        }
         init_aesc(key,aiv,enc,&aesc);
         uint64_t size = 0;
         uint64_t realsize = 0;
@@ -37,13 +45,14 @@ int mainenc(int enc,char* infn,char* outfn){
             fwrite(&size,1,8,fw);
 
             while(!feof(fr)){
-                char data[16];
-                memset(data,0,16);
-                uint64_t rst = fread(data,1,16,fr);
+                uint64_t rst = fread(data,1,GJ_AES_CHUNK,fr);
                 if(rst){
                     size +=rst;
-                    do_aesc(aesc,data,16,result,&outlen);
-                    fwrite(result,1,outlen,fw);
+                    //the last block is zero padded like before
+                    uint64_t pad = (rst+15)&~15ull;
+                    memset(data+rst,0,pad-rst);
+                    do_aesc_mt(aesc,data,pad,data,1);
+                    fwrite(data,1,pad,fw);
                 }
             }
             fseek(fw,8,0);
@@ -66,22 +75,25 @@ int mainenc(int enc,char* infn,char* outfn){
                 break;
             }
             while(!feof(fr)){
-                char data[16];
-                memset(data,0,16);
-                uint64_t rst = fread(data,1,16,fr);
+                uint64_t rst = fread(data,1,GJ_AES_CHUNK,fr);
                 if(rst){
-                    size +=rst;
-                    do_aesc(aesc,data,16,result,&outlen);
-                    if(size>realsize){
-                        outlen -= (size-realsize);
+                    uint64_t pad = (rst+15)&~15ull;
+                    memset(data+rst,0,pad-rst);
+                    do_aesc_mt(aesc,data,pad,data,0);
+                    uint64_t outsize = rst;
+                    if(size+rst>realsize){
+                        outsize = size<realsize?realsize-size:0;
                         //printf("===%lu > %lu rst %lu %d outlen \n",size,realsize,rst,outlen);
                     }
-                    fwrite(result,1,outlen,fw);
+                    size +=rst;
+                    if(outsize)fwrite(data,1,outsize,fw);
                 }
             }
         }
         break;
     }
+    if(aesc) free_aesc(&aesc);
+    if(data) free(data);
     if(fr) fclose(fr);
     if(fw) fclose(fw);
     return encrst;
@@ -73,14 +73,8 @@ protected:
 	        //ssize_t readed = read(m_fd, eback() + unget_sz, nmemb);
             if(rd>0){
                 cur_size += rd;
-                int cnt = leftb /16;
-                int k;
-                for(k=0;k<cnt;k++){
-                    int outlen = 0;
-                    do_aesc(aesc,pbuf,16,pdst,&outlen);
-                    pbuf += 16;
-                    pdst += 16;
-                }
+                int outlen = 0;
+                do_aesc(aesc,pbuf,leftb,pdst,&outlen);
 		        setg(eback(), eback() + unget_sz, eback() + unget_sz + rd);
 		        __c = traits_type::to_int_type(*gptr());
             }
@@ -97,8 +91,8 @@ public:
         fseek(file, 0, SEEK_END);
         file_size = ftell(file); //获取音频文件大小
         fseek(file, 0, SEEK_SET);
-        char* key = "yymrjzbwyrbjszrk";
-        char* aiv = "yymrjzbwyrbjszrk";
+        char key[] = "yymrjzbwyrbjszrk";
+        char aiv[] = "yymrjzbwyrbjszrk";
         init_aesc(key,aiv,0,&this->aesc);
         char head[50];
         memset(head,0,50);
@@ -138,6 +132,44 @@ GaesIStream::~GaesIStream()
     delete rdbuf();
 }
 
+int gaes_decrypt(const std::string& filename,std::vector<char>& out){
+    out.clear();
+    FILE* fr = fopen(filename.c_str(),"rb");
+    if(!fr)return -1001;
+    fseek(fr,0,SEEK_END);
+    long fsize = ftell(fr);
+    fseek(fr,0,SEEK_SET);
+    char head[32];
+    if((fsize<32)||(fread(head,1,32,fr)!=32)){
+        fclose(fr);
+        return -1003;
+    }
+    if((head[0]!='g')||(head[1]!='j')){
+        fclose(fr);
+        return -1004;
+    }
+    uint64_t realsize = *(uint64_t*)(head+8);
+    uint64_t encsize = (fsize-32)&~15l;
+    if((realsize>1034*1024*1024)||(realsize>encsize)){
+        fclose(fr);
+        return -1005;
+    }
+    std::vector<char> enc(encsize);
+    uint64_t rd = encsize?fread(enc.data(),1,encsize,fr):0;
+    fclose(fr);
+    if(rd!=encsize)return -1003;
+
+    char key[] = "yymrjzbwyrbjszrk";
+    char aiv[] = "yymrjzbwyrbjszrk";
+    gj_aesc_t* aesc = NULL;
+    if(init_aesc(key,aiv,0,&aesc))return -1006;
+    out.resize(encsize);
+    if(encsize)do_aesc_mt(aesc,enc.data(),encsize,out.data(),0);
+    free_aesc(&aesc);
+    out.resize(realsize);
+    return 0;
+}
+
 #ifdef TEST
 int maindec(int argc,char** argv){
     std::string filename(argv[1]);// = "test.enc";
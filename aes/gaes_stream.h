@@ -2,6 +2,8 @@
 #define COMPRESSED_STREAMS_ZSTD_STREAM_H
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 
 
@@ -15,6 +17,10 @@ public:
     virtual ~GaesIStream();
 };
 
+//decrypt a whole gjdigits file into memory, nothing is written to disk
+//returns 0 or the same negative codes as mainenc
+int gaes_decrypt(const std::string& filename,std::vector<char>& out);
+
 
 
 
@@ -1,16 +1,24 @@
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "gj_aes.h"
 #include "base64.h"
 
 #include "aes.h"
+#include "aes_ni.h"
 
+//smallest chunk given to a decrypt thread
+#define GJ_AES_MTCHUNK  (256*1024)
+#define GJ_AES_MAXTHREAD 64
 
 struct gj_aesc_s{
     char key[16];
     char iv[16];
     int enc;
 	AES_KEY *aeskey;
+    int ni;
+    unsigned char nikey[176];
 };
 
 int free_aesc(gj_aesc_t** paesc){
@@ -38,23 +46,91 @@ int init_aesc(char* key,char* iv,int enc,gj_aesc_t** paesc){
     }else{
 	    AES_set_decrypt_key((const unsigned char*)aesc->key, 128, aesc->aeskey);
     }
+    aesc->ni = aesni_supported();
+    if(aesc->ni){
+        aesni_set_key128((const unsigned char*)aesc->key,enc?aesc->nikey:NULL,enc?NULL:aesc->nikey);
+    }
     *paesc = aesc;
     return 0;
 }
 
+static void cbc_blocks(gj_aesc_t* aesc,const char* in,char* out,size_t blocks,unsigned char* iv){
+    if(aesc->ni){
+        if(aesc->enc){
+            aesni_cbc_encrypt((const unsigned char*)in,(unsigned char*)out,blocks,aesc->nikey,iv);
+        }else{
+            aesni_cbc_decrypt((const unsigned char*)in,(unsigned char*)out,blocks,aesc->nikey,iv);
+        }
+    }else{
+	    AES_cbc_encrypt((const unsigned char*)in,(unsigned char*)out,blocks*16,aesc->aeskey,iv,aesc->enc);
+    }
+}
+
 int do_aesc(gj_aesc_t* aesc,char* in,int inlen,char* out,int* outlen){
-    char* psrc = in;
-    char* pdest = out;
-    int cnt = 0;
-    int left=inlen;
-    while(left>0){
-	    AES_cbc_encrypt((const unsigned char*)psrc,(unsigned char*)pdest,16,aesc->aeskey,(unsigned char*)aesc->iv,aesc->enc);
-        psrc += 16;
-        pdest += 16;
-        left -= 16;
-        cnt += 16;
+    //whole buffer in one call, a partial tail block is still processed as 16
+    size_t blocks = inlen>0?(inlen+15)/16:0;
+    cbc_blocks(aesc,in,out,blocks,(unsigned char*)aesc->iv);
+    *outlen = blocks*16;
+    return 0;
+}
+
+typedef struct{
+    gj_aesc_t*      aesc;
+    const char*     in;
+    char*           out;
+    size_t          blocks;
+    unsigned char   iv[16];
+}gj_aes_part_t;
+
+static void* cbc_part(void* arg){
+    gj_aes_part_t* part = (gj_aes_part_t*)arg;
+    cbc_blocks(part->aesc,part->in,part->out,part->blocks,part->iv);
+    return NULL;
+}
+
+int do_aesc_mt(gj_aesc_t* aesc,const char* in,size_t inlen,char* out,int threads){
+    if(inlen%16)return -1;
+    size_t blocks = inlen/16;
+    if(threads<=0)threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads>GJ_AES_MAXTHREAD)threads = GJ_AES_MAXTHREAD;
+    if(threads>(int)(inlen/GJ_AES_MTCHUNK))threads = (int)(inlen/GJ_AES_MTCHUNK);
+    if(aesc->enc||(threads<=1)){
+        cbc_blocks(aesc,in,out,blocks,(unsigned char*)aesc->iv);
+        return 0;
+    }
+    //each chunk starts from the cipher block before it, taken before any
+    //thread writes so in place decrypt stays correct
+    gj_aes_part_t parts[GJ_AES_MAXTHREAD];
+    pthread_t tids[GJ_AES_MAXTHREAD];
+    size_t per = blocks/threads;
+    size_t start = 0;
+    int k;
+    for(k=0;k<threads;k++){
+        gj_aes_part_t* part = parts+k;
+        part->aesc = aesc;
+        part->in = in+start*16;
+        part->out = out+start*16;
+        part->blocks = (k==threads-1)?(blocks-start):per;
+        if(k){
+            memcpy(part->iv,in+start*16-16,16);
+        }else{
+            memcpy(part->iv,aesc->iv,16);
+        }
+        start += part->blocks;
+    }
+    memcpy(aesc->iv,in+inlen-16,16);
+    int started = 0;
+    for(k=1;k<threads;k++){
+        if(pthread_create(tids+k,NULL,cbc_part,parts+k))break;
+        started = k;
+    }
+    cbc_part(parts);
+    for(k=1;k<=started;k++){
+        pthread_join(tids[k],NULL);
+    }
+    for(k=started+1;k<threads;k++){
+        cbc_part(parts+k);
     }
-    *outlen = cnt;
     return 0;
 }
 
@@ -2,6 +2,7 @@
 #define __GJ_AES_H__
 
 #include "gj_dll.h"
+#include <stddef.h>
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -12,6 +13,9 @@ GJLIBAPI int free_aesc(gj_aesc_t** paesc);
 GJLIBAPI int init_aesc(char* key,char* iv,int enc,gj_aesc_t** paesc);
 
 GJLIBAPI int do_aesc(gj_aesc_t* aesc,char* in,int inlen,char* out,int* outlen);
+//cbc decrypt split into chunks over threads (0 for one per cpu), inlen is a
+//multiple of 16, in and out may be the same buffer. encrypt runs serially
+GJLIBAPI int do_aesc_mt(gj_aesc_t* aesc,const char* in,size_t inlen,char* out,int threads);
 
 GJLIBAPI int do_base64(int enc,char* in,int inlen,char* out,int* outlen);
 
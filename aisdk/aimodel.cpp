@@ -1,6 +1,10 @@
 #include "aimodel.h"
+#include "cpu.h"
 #include <stdlib.h>
 #include <string.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
 
 void AiCfg::dump(){
     int incnt = size_inputs.size();
@@ -128,6 +132,15 @@ int AiModel::initModel(std::string& binfn,std::string& paramfn){
     return m_inited;
 }
 
+int AiModel::initModel(const char* data,size_t size){
+    m_modeldata = data;
+    m_modelsize = size;
+    m_inited = doInitModel();
+    m_modeldata = nullptr;
+    m_modelsize = 0;
+    return m_inited;
+}
+
 int AiModel::doRunModel(void** arrin,void** arrout,void* stream,AiCfg* pcfg){
     return 0;
 }
@@ -153,22 +166,113 @@ OnnxModel::OnnxModel(int b,int w,int h):AiModel(){
 OnnxModel::~OnnxModel(){
 }
 
+//one env per process shared by every session instead of one per model;
+//never destroyed so sessions held by statics can still be released at exit
+static Ort::Env& onnxenv(){
+    static Ort::Env* env = new Ort::Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "ONNX");
+    return *env;
+}
+
+Ort::SessionOptions OnnxModel::makeOptions(){
+    Ort::SessionOptions options;
+    options.SetGraphOptimizationLevel((GraphOptimizationLevel)m_opts.graphopt);
+    if(m_opts.intrathreads>0)options.SetIntraOpNumThreads(m_opts.intrathreads);
+    if(m_opts.interthreads>0)options.SetInterOpNumThreads(m_opts.interthreads);
+    if(!m_opts.memarena)options.DisableCpuMemArena();
+    if(!m_opts.mempattern)options.DisableMemPattern();
+    return options;
+}
+
+//isa extensions the optimized graph may have picked kernels for
+static std::string cpufeatures(){
+    std::string key;
+    key += ncnn::cpu_support_x86_avx()?"avx,":"";
+    key += ncnn::cpu_support_x86_fma()?"fma,":"";
+    key += ncnn::cpu_support_x86_avx2()?"avx2,":"";
+    key += ncnn::cpu_support_x86_avx_vnni()?"avxvnni,":"";
+    key += ncnn::cpu_support_x86_avx512()?"avx512,":"";
+    key += ncnn::cpu_support_x86_avx512_vnni()?"avx512vnni,":"";
+    key += ncnn::cpu_support_x86_avx512_bf16()?"avx512bf16,":"";
+    key += ncnn::cpu_support_x86_avx512_fp16()?"avx512fp16,":"";
+    key += ncnn::cpu_support_arm_asimdhp()?"asimdhp,":"";
+    key += ncnn::cpu_support_arm_asimddp()?"asimddp,":"";
+    key += ncnn::cpu_support_arm_i8mm()?"i8mm,":"";
+    key += ncnn::cpu_support_arm_bf16()?"bf16,":"";
+    key += ncnn::cpu_support_arm_sve()?"sve,":"";
+    return key;
+}
+
+//cache name: hash of the model bytes, runtime version, optimization level
+//and cpu features, an ORT_ENABLE_ALL graph is specific to the hardware
+std::string OnnxModel::cacheFile(const char* data,size_t size){
+    static const std::string cpu = cpufeatures();
+    std::string key = Ort::GetVersionString()+":"+std::to_string(m_opts.graphopt)+":"+cpu;
+    size_t hash = std::hash<std::string_view>()(std::string_view(data,size));
+    hash ^= std::hash<std::string>()(key)+0x9e3779b97f4a7c15ULL+(hash<<6)+(hash>>2);
+    char name[64];
+    snprintf(name,sizeof(name),"/%016zx.ort",hash);
+    return m_opts.cachedir+name;
+}
+
 int OnnxModel::doInitModel(){
-    env = Ort::Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "ONNX");
-    sessionOptions = Ort::SessionOptions();
-    //sessionOptions.AddConfigEntry("session.load_model_format","ORT");
-    //std::vector<std::string> availableProviders = Ort::GetAvailableProviders();
-    //auto cudaAvailable = std::find(availableProviders.begin(), availableProviders.end(), "CUDAExecutionProvider");
-    //OrtCUDAProviderOptions cudaOption;
-
-    //if(cudaAvailable != availableProviders.end()){
-        //std::cout << "Inference device: GPU" << std::endl;
-        //sessionOptions.AppendExecutionProvider_CUDA(cudaOption);
-    //}else{
-        //std::cout << "Inference device: CPU" << std::endl;
-    //}
-
-    session = Ort::Session(env, m_modelPath.c_str(), sessionOptions);
+    Ort::Env& env = onnxenv();
+    const char* data = m_modeldata;
+    size_t size = m_modelsize;
+    std::vector<char> filebuf;
+    std::string cachefn;
+    if(!m_opts.cachedir.empty()){
+        if(!data){
+            std::ifstream in(m_modelPath,std::ios::binary);
+            filebuf.assign(std::istreambuf_iterator<char>(in),std::istreambuf_iterator<char>());
+            data = filebuf.data();
+            size = filebuf.size();
+        }
+        if(size)cachefn = cacheFile(data,size);
+    }
+    //optimized graph saved by an earlier run, skip optimization entirely
+    if(!cachefn.empty()&&access(cachefn.c_str(),R_OK)==0){
+        try{
+            Ort::SessionOptions options = makeOptions();
+            options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+            options.AddConfigEntry("session.load_model_format","ORT");
+            session = Ort::Session(env, cachefn.c_str(), options);
+        }catch(const Ort::Exception& e){
+            printf("===drop onnx cache %s:%s\n",cachefn.c_str(),e.what());
+            unlink(cachefn.c_str());
+            session = Ort::Session{nullptr};
+        }
+    }
+    if(!session){
+        Ort::SessionOptions options = makeOptions();
+        std::string tmpfn;
+        if(!cachefn.empty()){
+            //the cache is the plain model, keep it to this user
+            mkdir(m_opts.cachedir.c_str(),0700);
+            //unique per session, two sessions of one process may build the same graph
+            std::string tmpl = cachefn+".XXXXXX";
+            int fd = mkstemp(tmpl.data());
+            if(fd>=0){
+                ::close(fd);
+                tmpfn = tmpl;
+                options.AddConfigEntry("session.save_model_format","ORT");
+                options.SetOptimizedModelFilePath(tmpfn.c_str());
+            }
+        }
+        try{
+            if(data){
+                session = Ort::Session(env, data, size, options);
+            }else{
+                session = Ort::Session(env, m_modelPath.c_str(), options);
+            }
+        }catch(const Ort::Exception& e){
+            if(!tmpfn.empty())unlink(tmpfn.c_str());
+            throw;
+        }
+        //renamed into place so no process loads a half written cache
+        if(!tmpfn.empty()&&(chmod(tmpfn.c_str(),0600)||rename(tmpfn.c_str(),cachefn.c_str()))){
+            unlink(tmpfn.c_str());
+        }
+    }
     //Ort::AllocatorWithDefaultOptions allocator;
     size_t numInputNodes = session.GetInputCount();
     size_t numOutputNodes = session.GetOutputCount();
@@ -268,6 +372,7 @@ NcnnModel::~NcnnModel(){
 
 int NcnnModel::doInitModel(){
     net.clear();
+    ncnnprec_apply(net.opt,m_prec);
     net.load_param(m_modelparam.c_str());
     net.load_model(m_modelbin.c_str());
     return 0;    //
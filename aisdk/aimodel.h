@@ -29,14 +29,28 @@ struct AiCfg{
     AiCfg clone();
 };
 
+//runtime options, set before initModel; only OnnxModel uses them for now
+struct AiOpts{
+    int         graphopt = 99;      //GraphOptimizationLevel, 99 is ORT_ENABLE_ALL
+    int         intrathreads = 0;   //0 lets the runtime decide
+    int         interthreads = 0;
+    bool        memarena = true;
+    bool        mempattern = true;
+    //optimized models are saved here keyed by model hash, empty disables
+    std::string cachedir;
+};
+
 class AiModel{
     protected:
         int                 m_inited;
         std::string         m_modelPath;
         std::string         m_modelbin;
         std::string         m_modelparam;
+        const char*         m_modeldata = nullptr;
+        size_t              m_modelsize = 0;
 
         AiCfg               *m_cfg;
+        AiOpts              m_opts;
 
         virtual int doInitModel();
         virtual int doRunModel(void** arrin,void** arrout,void* stream,AiCfg* pcfg=nullptr);
@@ -44,8 +58,11 @@ class AiModel{
         void dump();
         AiCfg config();
         int pushName(const char* name,int input);
+        void setOpts(const AiOpts& opts){m_opts = opts;};
         int initModel(std::string& modelpath);
         int initModel(std::string& binfn,std::string& paramfn);
+        //model bytes only need to live during the call
+        int initModel(const char* data,size_t size);
         int runModel(void** arrin,void** arrout,void* stream,AiCfg* pcfg = nullptr);
         AiModel();
         virtual ~AiModel();
@@ -59,9 +76,9 @@ class OnnxModel:public AiModel{
         int m_batch = 0;
         int m_width = 640;
         int m_height = 960;
-        Ort::Env env{nullptr};
-        Ort::SessionOptions sessionOptions{nullptr};
         Ort::Session session{nullptr};
+        Ort::SessionOptions makeOptions();
+        std::string cacheFile(const char* data,size_t size);
         int doInitModel()override;
         int doRunModel(void** arrin,void** arrout,void* stream,AiCfg* pcfg=nullptr)override;
     public:
@@ -74,14 +91,18 @@ class OnnxModel:public AiModel{
 #define _NCNN_
 #ifdef _NCNN_
 #include "net.h"
+#include "ncnnprec.h"
 class NcnnModel:public AiModel{
     protected:
         int m_width = 160;
         int m_height = 160;
         ncnn::Net net;
+        NcnnPrec m_prec;
         int doInitModel()override;
         int doRunModel(void** arrin,void** arrout,void* stream,AiCfg* pcfg=nullptr)override;
     public:
+        //takes effect on the next initModel
+        void setPrec(const NcnnPrec& prec){m_prec = prec;};
         NcnnModel(int w,int h);
         NcnnModel();
         virtual ~NcnnModel();
@@ -106,6 +106,32 @@ int diffbuf(char* abuf,char* bbuf,int size){
     return diff;
 }
 
+double diffssim(const cv::Mat& a,const cv::Mat& b){
+    const double c1 = 6.5025, c2 = 58.5225;
+    cv::Mat x, y;
+    a.convertTo(x, CV_32F);
+    b.convertTo(y, CV_32F);
+    cv::Mat xx = x.mul(x), yy = y.mul(y), xy = x.mul(y);
+    cv::Mat mx, my, sxx, syy, sxy;
+    cv::GaussianBlur(x, mx, cv::Size(11, 11), 1.5);
+    cv::GaussianBlur(y, my, cv::Size(11, 11), 1.5);
+    cv::GaussianBlur(xx, sxx, cv::Size(11, 11), 1.5);
+    cv::GaussianBlur(yy, syy, cv::Size(11, 11), 1.5);
+    cv::GaussianBlur(xy, sxy, cv::Size(11, 11), 1.5);
+    cv::Mat mxx = mx.mul(mx), myy = my.mul(my), mxy = mx.mul(my);
+    sxx -= mxx;
+    syy -= myy;
+    sxy -= mxy;
+    cv::Mat num = (2 * mxy + c1).mul(2 * sxy + c2);
+    cv::Mat den = (mxx + myy + c1).mul(sxx + syy + c2);
+    cv::Mat map;
+    cv::divide(num, den, map);
+    cv::Scalar mean = cv::mean(map);
+    double sum = 0;
+    for(int k=0;k<a.channels();k++)sum += mean[k];
+    return sum/a.channels();
+}
+
 uint64_t timer_msstamp() {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -15,6 +15,8 @@ void dumpfloat(float* abuf,int len);
 void dumpdouble(double* abuf,int len);
 int dumpfile(char* file,char** pbuf);
 int diffbuf(char* abuf,char* bbuf,int size);
+//ssim of two images of the same size, 11x11 gaussian window, channels averaged
+double diffssim(const cv::Mat& a,const cv::Mat& b);
 
 uint64_t timer_msstamp();
 
@@ -0,0 +1,131 @@
+#include "framecache.h"
+
+std::string MFrameCache::planekey(int frame,int kind){
+    char key[32];
+    snprintf(key,sizeof(key),"#%d.%d",frame,kind);
+    return std::string(key);
+}
+
+int MFrameCache::has(const std::string& key){
+    std::lock_guard<std::mutex> lock(*m_lock);
+    return map_mat.count(key)?1:0;
+}
+
+int MFrameCache::getkey(const std::string& key,JMat* dst){
+    JMat* mat = NULL;
+    m_lock->lock();
+    auto it = map_mat.find(key);
+    if(it!=map_mat.end()){
+        mat = it->second;
+        m_hits++;
+    }else{
+        m_miss++;
+    }
+    m_lock->unlock();
+    if(!mat)return -1;
+    //entries are immutable once inserted, copy outside the lock
+    return dst->loadmat(mat);
+}
+
+int MFrameCache::putkey(const std::string& key,JMat* src){
+    uint64_t size = src->size();
+    if(!size)return -2;
+    m_lock->lock();
+    if(map_mat.count(key)){
+        m_lock->unlock();
+        return 1;
+    }
+    if(m_used+size>m_budget){
+        m_lock->unlock();
+        return -1;
+    }
+    m_used += size;
+    m_lock->unlock();
+    JMat* mat = src->refclone(0);
+    m_lock->lock();
+    if(map_mat.count(key)){
+        m_used -= size;
+        delete mat;
+    }else{
+        map_mat[key] = mat;
+    }
+    m_lock->unlock();
+    return 0;
+}
+
+int MFrameCache::get(int frame,int kind,JMat* dst){
+    return getkey(planekey(frame,kind),dst);
+}
+
+int MFrameCache::put(int frame,int kind,JMat* src){
+    return putkey(planekey(frame,kind),src);
+}
+
+int MFrameCache::get(const std::string& fn,JMat* dst){
+    return getkey(fn,dst);
+}
+
+int MFrameCache::put(const std::string& fn,JMat* src){
+    return putkey(fn,src);
+}
+
+int MFrameCache::fill(RolePack* pack,int frame,int planes){
+    if(!pack)return -997;
+    JMat mat;
+    for(int k=0;k<GPK_PLANES;k++){
+        if(!(planes&GPK_BIT(k)))continue;
+        const uint8_t* buf = NULL;
+        uint32_t size = 0;
+        if(pack->plane(frame,k,&buf,&size))continue;
+        int rst = mat.loadjpg(buf,size);
+        if(rst)return rst;
+        rst = put(frame,k,&mat);
+        if(rst<0)return rst;
+    }
+    return 0;
+}
+
+int MFrameCache::fill(const std::string& fn){
+    if(!fn.length())return 0;
+    JMat mat;
+    int rst = mat.load(fn);
+    if(rst)return rst;
+    rst = put(fn,&mat);
+    return rst<0?rst:0;
+}
+
+int MFrameCache::full(){
+    std::lock_guard<std::mutex> lock(*m_lock);
+    return m_used>=m_budget;
+}
+
+uint64_t MFrameCache::used(){
+    std::lock_guard<std::mutex> lock(*m_lock);
+    return m_used;
+}
+
+uint64_t MFrameCache::budget(){
+    return m_budget;
+}
+
+void MFrameCache::debug(){
+    std::lock_guard<std::mutex> lock(*m_lock);
+    printf("===framecache entries %d used %lu/%lu hits %lu miss %lu\n",
+            (int)map_mat.size(),(unsigned long)m_used,(unsigned long)m_budget,
+            (unsigned long)m_hits,(unsigned long)m_miss);
+}
+
+MFrameCache::MFrameCache(uint64_t budget){
+    m_lock = new std::mutex();
+    m_budget = budget;
+}
+
+MFrameCache::~MFrameCache(){
+    m_lock->lock();
+    for(auto& it:map_mat){
+        delete it.second;
+    }
+    map_mat.clear();
+    m_lock->unlock();
+    delete m_lock;
+}
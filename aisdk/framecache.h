@@ -0,0 +1,40 @@
+#pragma once
+#include "jmat.h"
+#include "rolepack.h"
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+/*
+ * decoded frame cache of one role
+ *
+ * entries are keyed by pack frame/plane or by file name, filled lazily
+ * (or preloaded) and never evicted: the role's frame set is fixed, so
+ * once the byte budget is used up later frames simply keep decoding.
+ * */
+class MFrameCache{
+    private:
+        uint64_t    m_budget = 0;
+        uint64_t    m_used = 0;
+        uint64_t    m_hits = 0;
+        uint64_t    m_miss = 0;
+        std::mutex  *m_lock;
+        std::unordered_map<std::string,JMat*>   map_mat;
+        int     getkey(const std::string& key,JMat* dst);
+        int     putkey(const std::string& key,JMat* src);
+    public:
+        static std::string planekey(int frame,int kind);
+        int     has(const std::string& key);
+        int     get(int frame,int kind,JMat* dst);
+        int     put(int frame,int kind,JMat* src);
+        int     get(const std::string& fn,JMat* dst);
+        int     put(const std::string& fn,JMat* src);
+        int     fill(RolePack* pack,int frame,int planes = GPK_ALL);
+        int     fill(const std::string& fn);
+        int     full();
+        uint64_t    used();
+        uint64_t    budget();
+        void    debug();
+        MFrameCache(uint64_t budget);
+        virtual ~MFrameCache();
+};
@@ -0,0 +1,153 @@
+#include "jarena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+//each block starts with a header, the caller gets the bytes after it
+#define JARENA_HDR      64
+#define JARENA_MAGIC    0x6a6172656e61ULL
+
+typedef struct _jarena_blk{
+    uint64_t    csize;
+    uint64_t    magic;
+}jarena_blk;
+
+JArena* JArena::get(){
+    static JArena arena;
+    return &arena;
+}
+
+static uint64_t roundup(uint64_t size,uint64_t unit){
+    return (size+unit-1)/unit*unit;
+}
+
+int JArena::init(uint64_t capacity,int mode){
+    std::lock_guard<std::mutex> lock(m_lock);
+    if(m_base)return -1;
+    if(mode==JARENA_OFF||!capacity)return 0;
+    capacity = roundup(capacity,JARENA_HUGE);
+    void* addr = MAP_FAILED;
+    if(mode==JARENA_HUGETLB){
+        //no MAP_NORESERVE, a short pool fails here instead of SIGBUS on first touch
+        addr = mmap(NULL,capacity,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+        if(addr==MAP_FAILED){
+            printf("===arena hugetlb %lu failed, use thp\n",(unsigned long)capacity);
+            mode = JARENA_THP;
+        }
+    }
+    if(addr==MAP_FAILED){
+        //over reserve so the region can start on a huge page boundary
+        uint64_t span = capacity+JARENA_HUGE;
+        uint8_t* raw = (uint8_t*)mmap(NULL,span,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0);
+        if(raw==MAP_FAILED)return -2;
+        uint8_t* aligned = (uint8_t*)roundup((uint64_t)raw,JARENA_HUGE);
+        if(aligned>raw)munmap(raw,aligned-raw);
+        uint8_t* end = raw+span;
+        if(end>aligned+capacity)munmap(aligned+capacity,end-aligned-capacity);
+        addr = aligned;
+        if(madvise(addr,capacity,MADV_HUGEPAGE)){
+            printf("===arena madvise hugepage failed\n");
+        }
+    }
+    m_base = (uint8_t*)addr;
+    m_capacity = capacity;
+    m_mode = mode;
+    return 0;
+}
+
+void* JArena::alloc(size_t size){
+    if(!m_base)return NULL;
+    uint64_t total = size+JARENA_HDR;
+    //coarser classes above a huge page keep the free lists short without
+    //doubling a 2.2MB wav buffer; the region is contiguous so thp covers both
+    uint64_t csize = total<=JARENA_HUGE?roundup(total,JARENA_MIN):roundup(total,JARENA_HUGE/8);
+    uint8_t* blk = NULL;
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = map_free.find(csize);
+    if(it!=map_free.end()&&it->second.size()){
+        blk = it->second.back();
+        it->second.pop_back();
+    }else if(m_top+csize<=m_capacity){
+        blk = m_base+m_top;
+        m_top += csize;
+    }else{
+        m_fallbacks++;
+        return NULL;
+    }
+    jarena_blk* hdr = (jarena_blk*)blk;
+    hdr->csize = csize;
+    hdr->magic = JARENA_MAGIC;
+    m_inuse += csize;
+    m_allocs++;
+    return blk+JARENA_HDR;
+}
+
+void JArena::release(void* ptr){
+    uint8_t* blk = (uint8_t*)ptr-JARENA_HDR;
+    jarena_blk* hdr = (jarena_blk*)blk;
+    if(hdr->magic!=JARENA_MAGIC){
+        printf("===arena release bad block %p\n",ptr);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_inuse -= hdr->csize;
+    map_free[hdr->csize].push_back(blk);
+}
+
+//AnonHugePages of the smaps entries inside the region, madvise may have split it
+static uint64_t smapshuge(uint64_t begin,uint64_t end){
+    FILE* file = fopen("/proc/self/smaps","r");
+    if(!file)return 0;
+    char line[512];
+    int inside = 0;
+    uint64_t huge = 0;
+    while(fgets(line,sizeof(line),file)){
+        unsigned long lo = 0,hi = 0;
+        unsigned long kb = 0;
+        if(sscanf(line,"%lx-%lx ",&lo,&hi)==2){
+            inside = (lo>=begin)&&(hi<=end);
+        }else if(inside&&sscanf(line,"AnonHugePages: %lu kB",&kb)==1){
+            huge += (uint64_t)kb<<10;
+        }
+    }
+    fclose(file);
+    return huge;
+}
+
+int JArena::stat(jarena_stat* st){
+    memset(st,0,sizeof(jarena_stat));
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        st->mode = m_mode;
+        st->capacity = m_capacity;
+        st->mapped = m_top;
+        st->inuse = m_inuse;
+        st->allocs = m_allocs;
+        st->fallbacks = m_fallbacks;
+    }
+    if(m_mode==JARENA_HUGETLB){
+        st->huge = st->mapped;
+    }else if(m_mode==JARENA_THP){
+        st->huge = smapshuge((uint64_t)m_base,(uint64_t)(m_base+m_capacity));
+        //the last huge page faults in whole, count coverage of what was carved
+        if(st->huge>st->mapped)st->huge = st->mapped;
+    }
+    return 0;
+}
+
+void* jalloc(size_t size){
+    void* ptr = NULL;
+    if(size>=JARENA_MIN)ptr = JArena::get()->alloc(size);
+    return ptr?ptr:malloc(size);
+}
+
+void jfree(void* ptr){
+    if(!ptr)return;
+    JArena* arena = JArena::get();
+    if(arena->own(ptr)){
+        arena->release(ptr);
+    }else{
+        free(ptr);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+//blocks below this stay with malloc, the arena is for frame/feature/tensor buffers
+#define JARENA_MIN      (64*1024)
+#define JARENA_HUGE     (2*1024*1024)
+
+//backing of the arena region
+#define JARENA_OFF      0
+//anonymous memory with madvise(MADV_HUGEPAGE), transparent huge pages
+#define JARENA_THP      1
+//MAP_HUGETLB from the hugetlbfs pool, falls back to JARENA_THP if the pool is short
+#define JARENA_HUGETLB  2
+
+typedef struct _jarena_stat{
+    int         mode;       //backing in effect
+    uint64_t    capacity;   //reserved address space
+    uint64_t    mapped;     //bytes carved from the region so far
+    uint64_t    inuse;      //bytes handed out and not yet released
+    uint64_t    huge;       //mapped bytes currently backed by huge pages
+    uint64_t    allocs;
+    uint64_t    fallbacks;  //large blocks that went to malloc because the arena was full
+}jarena_stat;
+
+//one address range reserved at startup, large blocks are carved from it and
+//recycled by size class so hot buffers stay on the same (huge) pages.
+//memory is never returned to the os, capacity bounds it
+class JArena{
+    private:
+        std::mutex  m_lock;
+        int         m_mode = JARENA_OFF;
+        uint8_t*    m_base = nullptr;
+        uint64_t    m_capacity = 0;
+        uint64_t    m_top = 0;
+        uint64_t    m_inuse = 0;
+        uint64_t    m_allocs = 0;
+        uint64_t    m_fallbacks = 0;
+        std::map<uint64_t,std::vector<uint8_t*>>  map_free;
+        JArena(){};
+    public:
+        static JArena* get();
+        //reserve capacity bytes, call once before sessions start
+        int     init(uint64_t capacity,int mode);
+        //null when the arena is off or full
+        void*   alloc(size_t size);
+        void    release(void* ptr);
+        int     mode(){return m_mode;};
+        int     own(const void* ptr){return m_base&&((const uint8_t*)ptr>=m_base)&&((const uint8_t*)ptr<m_base+m_capacity);};
+        //huge reads /proc/self/smaps, not for hot paths
+        int     stat(jarena_stat* st);
+};
+
+//malloc/free for large buffers: arena first, malloc otherwise.
+//jfree takes any pointer from jalloc or malloc
+void*   jalloc(size_t size);
+void    jfree(void* ptr);
@@ -0,0 +1,59 @@
+#include "jmap.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int JMap::open(const char* fn,int owned){
+    if(m_addr)return -1;
+    int fd = ::open(fn,O_RDONLY|O_CLOEXEC|O_NOFOLLOW);
+    if(fd<0)return -2;
+    struct stat st;
+    if(fstat(fd,&st)||st.st_size<=0){
+        ::close(fd);
+        return -3;
+    }
+    if(owned&&(!S_ISREG(st.st_mode)||st.st_uid!=geteuid()||(st.st_mode&07777)!=0600)){
+        ::close(fd);
+        return -5;
+    }
+    void* addr = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);
+    if(addr==MAP_FAILED)return -4;
+    m_addr = addr;
+    m_size = st.st_size;
+    return 0;
+}
+
+int JMap::publish(const char* fn,const char* data,size_t size){
+    //unique per call, two threads of one process may publish the same fn
+    char tmp[1024];
+    if(snprintf(tmp,sizeof(tmp),"%s.XXXXXX",fn)>=(int)sizeof(tmp))return -1;
+    int fd = mkstemp(tmp);
+    if(fd<0)return -1;
+    size_t done = 0;
+    while(done<size){
+        ssize_t n = write(fd,data+done,size-done);
+        if(n<=0){
+            ::close(fd);
+            unlink(tmp);
+            return -2;
+        }
+        done += n;
+    }
+    ::close(fd);
+    if(rename(tmp,fn)){
+        unlink(tmp);
+        return -3;
+    }
+    return 0;
+}
+
+JMap::~JMap(){
+    if(m_addr){
+        munmap(m_addr,m_size);
+        m_addr = nullptr;
+    }
+}
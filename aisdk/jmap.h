@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+//read only mapping of a whole file, every process mapping the same file
+//shares its page cache pages; data stays valid until the JMap is destroyed
+class JMap{
+    private:
+        void*   m_addr = nullptr;
+        size_t  m_size = 0;
+    public:
+        const char* data(){return (const char*)m_addr;};
+        size_t      size(){return m_size;};
+        //owned: fn must be a regular file of this user with mode 0600, for
+        //files in shared directories such as /dev/shm that others could plant
+        int         open(const char* fn,int owned = 0);
+        //write data to fn through a temp file and rename, so other processes
+        //never map a half written file; fn should be on tmpfs (/dev/shm)
+        static int  publish(const char* fn,const char* data,size_t size);
+        JMap(){};
+        ~JMap();
+};
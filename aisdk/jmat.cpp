@@ -1,4 +1,5 @@
 #include "jmat.h"
+#include "jarena.h"
 
 extern "C"{
 #pragma pack(push)
@@ -37,13 +38,13 @@ JBuf::JBuf(uint32_t size,void* buf ){
     }else{
         m_ref = false;
         m_size = size;
-        m_buf = malloc(size+1024);
+        m_buf = jalloc(size+1024);
     }
 }
 
 JBuf::~JBuf(){
     if(!m_ref){
-        free(m_buf);
+        jfree(m_buf);
         m_buf = nullptr;
     }
 }
@@ -117,8 +118,8 @@ int JMat::loadgpg(std::string gpgfile){
 
             int imgSize  = ghead.size[0];
             if(m_size<imgSize){
-                if((!m_ref)&&m_buf)free(m_buf);
-                m_buf = malloc(imgSize);
+                if((!m_ref)&&m_buf)jfree(m_buf);
+                m_buf = jalloc(imgSize);
             }
             m_size = imgSize;
             m_width = ghead.width[0];
@@ -137,38 +138,69 @@ int JMat::loadgpg(std::string gpgfile){
 
 #ifdef USE_TURBOJPG
 #include "turbojpeg.h"
+static int readjpgfile(std::string picfile,unsigned char** pbuf,size_t* psize){
+    long size;
+    FILE *jpegFile = NULL;
+    const char* fn = picfile.c_str();
+    if ((jpegFile = fopen(fn, "rb")) == NULL)return -1;
+    if (fseek(jpegFile, 0, SEEK_END) < 0 || ((size = ftell(jpegFile)) < 0) || (fseek(jpegFile, 0, SEEK_SET) < 0)){
+        fclose(jpegFile);
+        return -2;
+    }
+    if (size == 0){
+        fclose(jpegFile);
+        return -3;
+    }
+    *psize = size;
+    *pbuf = (unsigned char*)tj3Alloc(size);
+    fread(*pbuf, size, 1, jpegFile);
+    fclose(jpegFile);
+    return 0;
+}
+
 int JMat::loadjpg(std::string picfile,int flag){
+    size_t jpegSize = 0;
+    unsigned char *jpegBuf = NULL;
+    int rst = readjpgfile(picfile,&jpegBuf,&jpegSize);
+    if(rst)return rst;
+    rst = loadjpg(jpegBuf,jpegSize,flag);
+    if(jpegBuf)tj3Free(jpegBuf);
+    jpegBuf = NULL;
+    return rst;
+}
+
+int JMat::loadjpgroi(std::string picfile,const int* box){
+    size_t jpegSize = 0;
+    unsigned char *jpegBuf = NULL;
+    int rst = readjpgfile(picfile,&jpegBuf,&jpegSize);
+    if(rst)return rst;
+    rst = loadjpgroi(jpegBuf,jpegSize,box);
+    if(jpegBuf)tj3Free(jpegBuf);
+    jpegBuf = NULL;
+    return rst;
+}
+
+int JMat::loadjpg(const uint8_t* jpgbuf,size_t jpgsize,int flag){
+    return loadjpgroi(jpgbuf,jpgsize,NULL);
+}
+
+/*
+ * box (x0,y0,x1,y1) limits decoding to the MCU blocks covering it, the
+ * pixels land at their full frame position and the rest of the buffer is
+ * left as it was. box NULL decodes the whole frame.
+ * */
+int JMat::loadjpgroi(const uint8_t* jpgbuf,size_t jpgsize,const int* box){
     tjhandle tjInstance = NULL;
     int rst = 0;
-    size_t jpegSize = 0;
     size_t imgSize = 0;
-    int newbuf = 0;
-    unsigned char *jpegBuf = NULL;
-    if(1){
-        long size;
-        FILE *jpegFile = NULL;
-        const char* fn = picfile.c_str();
-        if ((jpegFile = fopen(fn, "rb")) == NULL)return -1;
-        if (fseek(jpegFile, 0, SEEK_END) < 0 || ((size = ftell(jpegFile)) < 0) || (fseek(jpegFile, 0, SEEK_SET) < 0)){
-            fclose(jpegFile);
-            return -2;
-        }
-        if (size == 0){
-            fclose(jpegFile);
-            return -3;
-        }
-        jpegSize = size;
-        jpegBuf = (unsigned char*)tj3Alloc(jpegSize);
-        fread(jpegBuf, jpegSize, 1, jpegFile);
-        fclose(jpegFile);
-    }
+    if(!jpgbuf||!jpgsize)return -3;
     if ((tjInstance = tj3Init(TJINIT_DECOMPRESS)) == NULL)return -11;
     while(1){
         unsigned char *imgBuf = NULL;
         int w, h;
         int inSubsamp, inColorspace;
         int pixelFormat = TJPF_BGR;
-        rst = tj3DecompressHeader(tjInstance, jpegBuf, jpegSize);
+        rst = tj3DecompressHeader(tjInstance, jpgbuf, jpgsize);
         if(rst<0){
             rst = -12;
             break;
@@ -184,13 +216,36 @@ int JMat::loadjpg(std::string picfile,int flag){
         }
         //printf("===imgSize %d m_size %d\n",imgSize,m_size);
         if(m_size<imgSize){
-            if((!m_ref)&&m_buf)free(m_buf);
-            m_buf = malloc(imgSize);
+            if((!m_ref)&&m_buf)jfree(m_buf);
+            m_buf = jalloc(imgSize);
             m_ref = 0;
         }
         m_size = imgSize;
         imgBuf = (unsigned char *)m_buf;
-        if(tj3Decompress8(tjInstance, jpegBuf, jpegSize, imgBuf, 0, pixelFormat) < 0){
+        int pitch = w*tjPixelSize[pixelFormat];
+        if(box&&(inSubsamp>=0)&&(inSubsamp<TJ_NUMSAMP)){
+            int mcuw = tjMCUWidth[inSubsamp];
+            int mcuh = tjMCUHeight[inSubsamp];
+            int x0 = box[0]<0?0:box[0];
+            int y0 = box[1]<0?0:box[1];
+            int x1 = box[2]>w?w:box[2];
+            int y1 = box[3]>h?h:box[3];
+            x0 = x0/mcuw*mcuw;
+            y0 = y0/mcuh*mcuh;
+            x1 = (x1+mcuw-1)/mcuw*mcuw;
+            y1 = (y1+mcuh-1)/mcuh*mcuh;
+            if(x1>w)x1 = w;
+            if(y1>h)y1 = h;
+            if((x1>x0)&&(y1>y0)){
+                tjregion region = {x0,y0,x1-x0,y1-y0};
+                if(tj3SetCroppingRegion(tjInstance,region)<0){
+                    rst = -14;
+                    break;
+                }
+                imgBuf += y0*pitch + x0*tjPixelSize[pixelFormat];
+            }
+        }
+        if(tj3Decompress8(tjInstance, jpgbuf, jpgsize, imgBuf, pitch, pixelFormat) < 0){
             rst = -15;
             break;
         }
@@ -202,8 +257,6 @@ int JMat::loadjpg(std::string picfile,int flag){
         m_height = h;
         break;
     }
-    if(jpegBuf)tj3Free(jpegBuf);
-    jpegBuf = NULL;
     tj3Destroy(tjInstance);
     tjInstance = NULL;
     return rst;
@@ -213,6 +266,18 @@ int JMat::loadjpg(std::string picfile,int flag){
 int JMat::loadjpg(std::string picfile,int flag){
     return -1;
 }
+
+int JMat::loadjpg(const uint8_t* jpgbuf,size_t jpgsize,int flag){
+    return -1;
+}
+
+int JMat::loadjpgroi(std::string picfile,const int* box){
+    return -1;
+}
+
+int JMat::loadjpgroi(const uint8_t* jpgbuf,size_t jpgsize,const int* box){
+    return -1;
+}
 #endif
 
 JMat::JMat(int w,int h,float *buf ,int c  ,int d ):JBuf(){
@@ -247,7 +312,7 @@ JMat::JMat(int w,int h,int c ,int d ,int b):JBuf(){
     m_stride = d?d:w*c;
     m_size = m_bit*m_stride*m_height;
     //printf("===mat %d size %d\n",m_bit,m_size);
-    m_buf = malloc(m_size+m_bit*m_stride);
+    m_buf = jalloc(m_size+m_bit*m_stride);
     memset(m_buf,0,m_size+m_bit*m_stride);
     m_ref = 0;
     init_tagarr();
@@ -312,6 +377,23 @@ JMat* JMat::refclone(int ref){
     }
 }
 
+int JMat::loadmat(JMat* src){
+    if(!src||!src->m_buf)return -1;
+    if((m_size<src->m_size)||m_ref){
+        if((!m_ref)&&m_buf)jfree(m_buf);
+        m_buf = jalloc(src->m_size);
+        m_ref = 0;
+    }
+    m_size = src->m_size;
+    memcpy(m_buf,src->m_buf,m_size);
+    m_bit = src->m_bit;
+    m_channel = src->m_channel;
+    m_stride = src->m_stride;
+    m_width = src->m_width;
+    m_height = src->m_height;
+    return 0;
+}
+
 JMat JMat::clone(){
     JMat cm(m_width,m_height,m_channel,m_stride,m_bit);
     //printf("==clone %d\n",m_size);
@@ -330,7 +412,7 @@ JMat::JMat(std::string picfile,int flag):JBuf(){
                   //printf("===channels %d\n",m_channel);
     m_stride = m_width*m_channel;
     m_size = m_bit*m_stride*m_height;
-    m_buf = malloc(m_size+m_bit*m_stride);
+    m_buf = jalloc(m_size+m_bit*m_stride);
     m_ref = 0;
     if(flag){
         memcpy(m_buf,image.data,m_size);
@@ -67,6 +67,10 @@ class JMat:public JBuf{
         JMat();
         int load(std::string picfile);
         int loadjpg(std::string picfile,int flag=0);
+        int loadjpg(const uint8_t* jpgbuf,size_t jpgsize,int flag=0);
+        int loadjpgroi(std::string picfile,const int* box);
+        int loadjpgroi(const uint8_t* jpgbuf,size_t jpgsize,const int* box);
+        int loadmat(JMat* src);
         int savegpg(std::string gpgfile);
         int loadgpg(std::string gpgfile);
         float* fdata();
@@ -10,9 +10,9 @@ MWorkMat::MWorkMat(JMat* pic,JMat* msk,const int* boxs){
     //printf("x %d y %d w %d h %d \n",m_boxx,m_boxy,m_boxwidth,m_boxheight);
     m_pic = pic;
     m_msk = msk;
+    m_key = msk?1:0;
 
     pic_real160 = new JMat(160,160,3,0,1);
-    pic_mask160 = new JMat(160,160,3,0,1);
     //pic_crop160 = new JMat(160,160,3,0,1);
 
     msk_real160 = new JMat(160,160,1,0,1);
@@ -25,28 +25,38 @@ MWorkMat::~MWorkMat(){
     matpic_org168.release();
     matpic_roirst.release();
     delete pic_real160;
-    delete pic_mask160;
     delete msk_real160;
     if(pic_clone160) delete pic_clone160;
 }
 
 int MWorkMat::munet(JMat** ppic,JMat** pmsk){
     *ppic = pic_real160;
-    *pmsk = pic_mask160;
+    //Mobunet::input masks the mouth box while normalizing
+    *pmsk = NULL;
     return 0;
 }
 
 int MWorkMat::premunet(){
     matpic_roisrc = cv::Mat(m_pic->cvmat(),cv::Rect(m_boxx,m_boxy,m_boxwidth,m_boxheight));
     cv::resize(matpic_roisrc , matpic_org168, cv::Size(168, 168), cv::INTER_AREA);
+    return cropmunet();
+}
+
+int MWorkMat::premunet(const uint8_t* face){
+    if(!face)return premunet();
+    //finmunet pastes the result into org168, the mapped face stays read only
+    matpic_org168.create(168,168,CV_8UC3);
+    memcpy(matpic_org168.data,face,168*168*3);
+    if(m_pic)matpic_roisrc = cv::Mat(m_pic->cvmat(),cv::Rect(m_boxx,m_boxy,m_boxwidth,m_boxheight));
+    return cropmunet();
+}
+
+int MWorkMat::cropmunet(){
     //vtacc
     matpic_roi160 = cv::Mat(matpic_org168,cv::Rect(4,4,160,160));
-    cv::Mat cvmask = pic_mask160->cvmat();
     cv::Mat cvreal = pic_real160->cvmat();
-    matpic_roi160.copyTo(cvmask);
     matpic_roi160.copyTo(cvreal);
     //cv::rectangle(cvmask,cv::Rect(5,5,150,150),cv::Scalar(0,0,0),-1);//,cv::LineTypes::FILLED);
-    cv::rectangle(cvmask,cv::Rect(5,5,150,145),cv::Scalar(0,0,0),-1);//,cv::LineTypes::FILLED);
     //cv::rectangle(cvmask,cv::Rect(4,4,152,152),cv::Scalar(0,0,0),-1);//,cv::LineTypes::FILLED);
     //cv::imwrite("cvmask.bmp",cvmask);
     //cv::waitKey(0);
@@ -58,7 +68,7 @@ int MWorkMat::finmunet(JMat* fgpic){
     cv::Mat cvreal = pic_real160->cvmat();
     cvreal.copyTo(matpic_roi160);
     //cv::imwrite("accpre.bmp",matpic_org168);
-    if(m_msk) vtacc((uint8_t*)matpic_org168.data,168*168);
+    if(m_key) vtacc((uint8_t*)matpic_org168.data,168*168);
     //cv::imwrite("accend.bmp",matpic_org168);
     cv::resize(matpic_org168, matpic_roirst, cv::Size(m_boxwidth, m_boxheight), cv::INTER_AREA);
     if(fgpic){
@@ -217,7 +227,8 @@ int MAlpha::doModel(JMat* real,JMat* img,JMat* pha){
     return 0;
 }
 
-MAlpha::MAlpha(const char* fnbin,const char* fnparam):NcnnModel(160,160){
+MAlpha::MAlpha(const char* fnbin,const char* fnparam,const NcnnPrec& prec):NcnnModel(160,160){
+    setPrec(prec);
     std::string fb(fnbin);
     std::string fp(fnparam);
     initModel(fb,fp);
@@ -16,9 +16,9 @@ class MWorkMat{
         int     m_boxheight;
         JMat*   m_pic;
         JMat*   m_msk;
+        int     m_key;
 
         JMat*   pic_real160;//blendimg
-        JMat*   pic_mask160;
 
         cv::Mat matpic_roisrc;//box area
         cv::Mat matpic_org168;
@@ -38,10 +38,16 @@ class MWorkMat{
         cv::Mat matmsk_roirst;
 
         int vtacc(uint8_t* buf,int count);
+        int cropmunet();
     public:
+        //pic may be NULL when premunet gets a compiled face and finmunet an fgpic
         MWorkMat(JMat* pic,JMat* msk,const int* boxs);
         int premunet();
+        //face: 168x168 BGR of the box compiled ahead (RoleFaces), NULL to cut it from pic
+        int premunet(const uint8_t* face);
         int munet(JMat** ppic,JMat** pmsk);
+        //green spill removal, on by default when a mask is given
+        void keygreen(int key){m_key = key;};
         int finmunet(JMat* fgpic=NULL);
         int prealpha();
         int alpha(JMat** preal,JMat** pimg,JMat** pmsk);
@@ -54,6 +60,6 @@ class MAlpha:public NcnnModel{
     private:
     public:
         int doModel(JMat* real,JMat* img,JMat* pha);
-        MAlpha(const char* fnbin,const char* fnparam);
+        MAlpha(const char* fnbin,const char* fnparam,const NcnnPrec& prec = NcnnPrec());
         virtual ~MAlpha();
 };
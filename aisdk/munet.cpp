@@ -2,28 +2,85 @@
 #include "cpu.h"
 #include "face_utils.h"
 #include "blendgram.h"
+#include "jarena.h"
+#include "munet_kernel.h"
+#include <digit/dispatchqueue.hpp>
+#include <future>
+#include <thread>
 
-Mobunet::Mobunet(const char* fnbin,const char* fnparam,const char* fnmsk){
-    initModel(fnbin,fnparam,fnmsk);
+Mobunet::MunetTap Mobunet::s_tap;
+
+//ncnn blobs and workspace from the arena, small blocks keep ncnn's aligned malloc
+class JArenaAllocator:public ncnn::Allocator{
+    public:
+        virtual void* fastMalloc(size_t size){
+            void* ptr = NULL;
+            //ncnn reads up to 64 bytes past a blob, like its own fastMalloc
+            if(size>=JARENA_MIN)ptr = JArena::get()->alloc(size+64);
+            return ptr?ptr:ncnn::fastMalloc(size);
+        }
+        virtual void fastFree(void* ptr){
+            if(JArena::get()->own(ptr)){
+                JArena::get()->release(ptr);
+            }else{
+                ncnn::fastFree(ptr);
+            }
+        }
+};
+
+static void setopt(ncnn::Option& opt){
+    static JArenaAllocator allocator;
+    opt.num_threads = ncnn::get_big_cpu_count();
+    if(JArena::get()->mode()!=JARENA_OFF){
+        opt.blob_allocator = &allocator;
+        opt.workspace_allocator = &allocator;
+    }
+}
+
+MunetModel::MunetModel(const char* fnbin,const char* fnparam,const char* fnmsk,const NcnnPrec& prec){
+    m_prec = prec;
+    m_ready = initModel(fnbin,fnparam,fnmsk)==0;
+}
+
+MunetModel::MunetModel(std::vector<char> bin,std::vector<char> param,std::vector<char> msk,const NcnnPrec& prec){
+    m_prec = prec;
+    m_ready = initModel(bin,param,msk)==0;
 }
 
-Mobunet::Mobunet(const char* modeldir,const char* modelid){
+MunetModel::MunetModel(std::shared_ptr<JMap> bin,std::vector<char> param,std::shared_ptr<JMap> msk,const NcnnPrec& prec){
+    m_prec = prec;
+    m_binmap = bin;
+    m_mskmap = msk;
+    if(!bin||!bin->size()||!msk||msk->size()<160*160)return;
+    m_ready = initModel((const unsigned char*)bin->data(),param,(uint8_t*)msk->data())==0;
+}
+
+Mobunet::Mobunet(std::shared_ptr<MunetModel> model){
+    m_model = model;
+}
+
+Mobunet::Mobunet(const char* fnbin,const char* fnparam,const char* fnmsk,const NcnnPrec& prec){
+    m_model = std::make_shared<MunetModel>(fnbin,fnparam,fnmsk,prec);
+}
+
+Mobunet::Mobunet(const char* modeldir,const char* modelid,const NcnnPrec& prec){
     char fnbin[1024];
     char fnparam[1024];
     char fnmsk[1024];
     sprintf(fnbin,"%s/%s.bin",modeldir,modelid);
     sprintf(fnparam,"%s/%s.param",modeldir,modelid);
     sprintf(fnmsk,"%s/weight_168u.bin",modeldir);
-    initModel(fnbin,fnparam,fnmsk);
+    m_model = std::make_shared<MunetModel>(fnbin,fnparam,fnmsk,prec);
 }
 
-int Mobunet::initModel(const char* binfn,const char* paramfn,const char* mskfn){
+int MunetModel::initModel(const char* binfn,const char* paramfn,const char* mskfn){
     unet.clear();
     //ncnn::set_cpu_powersave(2);
     //ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
     //unet.opt = ncnn::Option();
     //unet.opt.use_vulkan_compute = true;
-    unet.opt.num_threads = ncnn::get_big_cpu_count();
+    setopt(unet.opt);
+    ncnnprec_apply(unet.opt,m_prec);
     //unet.load_param("model/mobileunet_v5_wenet_sim.param");
     //unet.load_model("model/mobileunet_v5_wenet_sim.bin");
     unet.load_param(paramfn);
@@ -37,7 +94,38 @@ int Mobunet::initModel(const char* binfn,const char* paramfn,const char* mskfn){
     return 0;
 }
 
-Mobunet::~Mobunet(){
+int MunetModel::initModel(std::vector<char>& bin,std::vector<char>& param,std::vector<char>& msk){
+    unet.clear();
+    setopt(unet.opt);
+    ncnnprec_apply(unet.opt,m_prec);
+    //load_param_mem wants text ending with 0
+    param.push_back(0);
+    if(unet.load_param_mem(param.data()))return -1;
+    m_binbuf.swap(bin);
+    if(!m_binbuf.size())return -2;
+    if(!unet.load_model((const unsigned char*)m_binbuf.data()))return -3;
+    if(msk.size()<160*160)return -4;
+    char* wbuf = (char*)malloc(msk.size()+8000);
+    memcpy(wbuf,msk.data(),msk.size());
+    mat_weights = new JMat(160,160,(uint8_t*)wbuf,1);
+    mat_weights->forceref(0);
+    return 0;
+}
+
+int MunetModel::initModel(const unsigned char* bin,std::vector<char>& param,uint8_t* msk){
+    unet.clear();
+    setopt(unet.opt);
+    ncnnprec_apply(unet.opt,m_prec);
+    param.push_back(0);
+    if(unet.load_param_mem(param.data()))return -1;
+    //mmap is page aligned, ncnn keeps the weights in place instead of copying
+    if(!unet.load_model(bin))return -3;
+    //mask stays a reference, JMat never frees or writes it
+    mat_weights = new JMat(160,160,msk,1);
+    return 0;
+}
+
+MunetModel::~MunetModel(){
     unet.clear();
     if(mat_weights){
         delete mat_weights;
@@ -45,6 +133,9 @@ Mobunet::~Mobunet(){
     }
 }
 
+Mobunet::~Mobunet(){
+}
+
 int Mobunet::domodelold(JMat* pic,JMat* msk,JMat* feat){
     JMat  picall(160*160,2,3,0,1);
     uint8_t* buf = picall.udata();
@@ -59,7 +150,7 @@ int Mobunet::domodelold(JMat* pic,JMat* msk,JMat* feat){
     //inall.reshape(160,160,6);
     ncnn::Mat inwenet(256,20,1,feat->data());
     ncnn::Mat outpic;
-    ncnn::Extractor ex = unet.create_extractor();
+    ncnn::Extractor ex = m_model->net().create_extractor();
     ex.input("face", inall);
     ex.input("audio", inwenet);
     ex.extract("output", outpic);
@@ -79,18 +170,17 @@ int Mobunet::domodelold(JMat* pic,JMat* msk,JMat* feat){
     cv::imshow("cvmask",cvmask);
     //cv::waitKey(0);
     //getchar();
-    BlendGramAlpha((uchar*)cvmask.data,(uchar*)mat_weights->data(),(uchar*)pic->data(),160,160);
+    BlendGramAlpha((uchar*)cvmask.data,(uchar*)m_model->weights()->data(),(uchar*)pic->data(),160,160);
     return 0;
 }
 
-int Mobunet::domodel(JMat* pic,JMat* msk,JMat* feat){
-    //convert to bgr
-    //pic->tojpg("eee.bmp");
-
-    //JMat  picmask(160,160,3,0,1);
-    //JMat  picreal(160,160,3,0,1);
-    //cv::cvtColor(pic->cvmat(),picreal.cvmat(),cv::COLOR_RGB2BGR);
-    //cv::cvtColor(msk->cvmat(),picmask.cvmat(),cv::COLOR_RGB2BGR);
+int Mobunet::input(JMat* pic,JMat* msk,ncnn::Mat& inpic){
+    inpic.create(160,160,6);
+    if(!msk){
+        //standard mouth box, masked planes come out of the same pass
+        munet_input(pic->udata(),pic->stride(),munet_maskbox,(float*)inpic.data,inpic.cstep);
+        return 0;
+    }
     ncnn::Mat inmask = ncnn::Mat::from_pixels(msk->udata(), ncnn::Mat::PIXEL_BGR2RGB, 160, 160);
     inmask.substract_mean_normalize(mean_vals, norm_vals);
     ncnn::Mat inreal = ncnn::Mat::from_pixels(pic->udata(), ncnn::Mat::PIXEL_BGR2RGB, 160, 160);
@@ -104,7 +194,6 @@ int Mobunet::domodel(JMat* pic,JMat* msk,JMat* feat){
     //ncnn::Mat inpack(160,160,1,pd,(size_t)4u*6,6);
     //ncnn::Mat inpic;
     //ncnn::convert_packing(inpack,inpic,1);
-    ncnn::Mat inpic(160,160,6);
     //printf("===in %d %d all %d %d\n",inreal.cstep,inreal.elempack,inpic.cstep,inpic.elempack);
     float* buf = (float*)inpic.data;
     float* pr = (float*)inreal.data;
@@ -128,20 +217,43 @@ int Mobunet::domodel(JMat* pic,JMat* msk,JMat* feat){
         pm += inmask.cstep;
     }
     */
+    return 0;
+}
+
+int Mobunet::domodel(JMat* pic,JMat* msk,JMat* feat,int threads){
+    MunetTap tap = s_tap;
+    if(tap)tap(pic,msk,feat);
+    //convert to bgr
+    //pic->tojpg("eee.bmp");
+
+    //JMat  picmask(160,160,3,0,1);
+    //JMat  picreal(160,160,3,0,1);
+    //cv::cvtColor(pic->cvmat(),picreal.cvmat(),cv::COLOR_RGB2BGR);
+    //cv::cvtColor(msk->cvmat(),picmask.cvmat(),cv::COLOR_RGB2BGR);
+    //per thread input, service workers reuse it frame after frame
+    static thread_local ncnn::Mat inpic;
+    input(pic,msk,inpic);
 
     ncnn::Mat inwenet(256,20,1,feat->data());
     //ncnn::Mat inwenet(20,256,1,feat->data());
     ncnn::Mat outpic;
-    ncnn::Extractor ex = unet.create_extractor();
-    ex.input("face", inpic);
-    ex.input("audio", inwenet);
-    ex.extract("output", outpic);
+    ncnn::Extractor ex = m_model->net().create_extractor();
+    if(threads>0)ex.set_num_threads(threads);
+    if(ex.input("face", inpic)||ex.input("audio", inwenet))return -1;
+    int rst = ex.extract("output", outpic);
+    if(rst)return rst;
+    if(outpic.empty())return -2;
+    //extract unpacks to fp32 chw, anything else takes the ncnn way
+    if(outpic.elempack==1&&outpic.elemsize==4){
+        munet_output((const float*)outpic.data,outpic.cstep,m_model->weights()->udata(),pic->udata(),pic->stride());
+        return 0;
+    }
     float outmean_vals[3] = {-1.0f, -1.0f, -1.0f};
     float outnorm_vals[3] = { 127.5f,  127.5f,  127.5f};
     outpic.substract_mean_normalize(outmean_vals, outnorm_vals);
     cv::Mat cvout(160,160,CV_8UC3);
     outpic.to_pixels(cvout.data,ncnn::Mat::PIXEL_RGB2BGR);
-    BlendGramAlpha((uchar*)cvout.data,(uchar*)mat_weights->data(),(uchar*)pic->data(),160,160);
+    BlendGramAlpha((uchar*)cvout.data,(uchar*)m_model->weights()->data(),(uchar*)pic->data(),160,160);
     //pic->tojpg("fff.bmp");
     //getchar();
     /*
@@ -157,7 +269,7 @@ int Mobunet::domodel(JMat* pic,JMat* msk,JMat* feat){
     //getchar();
     //cv::Mat cout;
     //cv::cvtColor(picreal.cvmat(),cout,cv::COLOR_RGB2BGR);
-    //BlendGramAlpha((uchar*)cout.data,(uchar*)mat_weights->data(),(uchar*)pic->data(),160,160);
+    //BlendGramAlpha((uchar*)cout.data,(uchar*)m_model->weights()->data(),(uchar*)pic->data(),160,160);
 
     /*
     float outmean_vals[3] = {-1.0f, -1.0f, -1.0f};
@@ -174,14 +286,45 @@ int Mobunet::domodel(JMat* pic,JMat* msk,JMat* feat){
     cvadj.convertTo(picreal.cvmat(),CV_8UC3,scale);
     cv::Mat cout;
     cv::cvtColor(picreal.cvmat(),cout,cv::COLOR_RGB2BGR);
-    BlendGramAlpha((uchar*)cout.data,(uchar*)mat_weights->data(),(uchar*)pic->data(),160,160);
-    //BlendGramAlpha((uchar*)picreal.udata(),(uchar*)mat_weights->data(),(uchar*)pic->data(),160,160);
+    BlendGramAlpha((uchar*)cout.data,(uchar*)m_model->weights()->data(),(uchar*)pic->data(),160,160);
+    //BlendGramAlpha((uchar*)picreal.udata(),(uchar*)m_model->weights()->data(),(uchar*)pic->data(),160,160);
     //cv::cvtColor(picreal.cvmat(),pic->cvmat(),cv::COLOR_RGB2BGR);
     */
     return 0;
 }
 
 
+//side runs of domodels, one thread per big core shared by every caller;
+//never destroyed, like the ncnn globals the runs use
+static DispatchQueue* munetruns(){
+    static DispatchQueue* pool = new DispatchQueue("MunetRuns",ncnn::get_big_cpu_count());
+    return pool;
+}
+
+int Mobunet::domodels(JMat** pics,JMat** msks,JMat** feats,int count,int threads){
+    if(count<=0)return 0;
+    int total = threads>0?threads:ncnn::get_big_cpu_count();
+    if(count==1)return domodel(pics[0],msks[0],feats[0],total);
+    //small convs scale poorly past a few threads, several narrow runs beat one wide
+    int each = total/count;
+    if(each<1)each = 1;
+    std::vector<std::shared_ptr<std::promise<int>>> runs;
+    for(int k=1;k<count;k++){
+        auto run = std::make_shared<std::promise<int>>();
+        runs.push_back(run);
+        munetruns()->dispatch([=](){
+            run->set_value(domodel(pics[k],msks[k],feats[k],each));
+        });
+    }
+    //frame 0 on the caller, the first failing frame decides the result
+    int rst = domodel(pics[0],msks[0],feats[0],each);
+    for(auto& run:runs){
+        int ret = run->get_future().get();
+        if(!rst)rst = ret;
+    }
+    return rst;
+}
+
 int Mobunet::preprocess(JMat* pic,JMat* feat){
     //pic 168
     cv::Mat roipic(pic->cvmat(),cv::Rect(4,4,160,160));
@@ -284,7 +427,7 @@ int Mobunet::process2(JMat* pic,const int* boxs,JMat* feat){
 //    dumpfile("wenet.bin",&pwenet);
     ncnn::Mat inwenet(256,20,1,feat->data(),4);
     ncnn::Mat outpic;
-    ncnn::Extractor ex = unet.create_extractor();
+    ncnn::Extractor ex = m_model->net().create_extractor();
     ex.input("face", inpic);
     ex.input("audio", inwenet);
     ex.extract("output", outpic);
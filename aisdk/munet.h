@@ -1,28 +1,82 @@
 #pragma once
 #include "jmat.h"
+#include "jmap.h"
 #include "net.h"
+#include "ncnnprec.h"
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <stdio.h>
+#include <functional>
 #include <vector>
 
 
-class Mobunet{
+//immutable half of the munet: the loaded ncnn net and the 160x160 blend
+//mask. one per role, shared by all its sessions through shared_ptr; ncnn
+//allows concurrent create_extractor() on a loaded net
+class MunetModel{
     private:
         ncnn::Net unet;
-        float mean_vals[3] = {127.5f, 127.5f, 127.5f};
-        float norm_vals[3] = {1 / 127.5f, 1 / 127.5f, 1 / 127.5f};
         JMat*   mat_weights = nullptr;
+        int     m_ready = 0;
+        NcnnPrec    m_prec;
+        //ncnn references the weights in place, keep them alive with the net
+        std::vector<char> m_binbuf;
+        std::shared_ptr<JMap> m_binmap;
+        std::shared_ptr<JMap> m_mskmap;
         int initModel(const char* binfn,const char* paramfn,const char* mskfn);
+        int initModel(std::vector<char>& bin,std::vector<char>& param,std::vector<char>& msk);
+        int initModel(const unsigned char* bin,std::vector<char>& param,uint8_t* msk);
+    public:
+        ncnn::Net&  net(){return unet;};
+        JMat*       weights(){return mat_weights;};
+        int         ready(){return m_ready;};
+        const NcnnPrec& prec(){return m_prec;};
+        //prec: storage/arithmetic precision and layout, fixed once loaded
+        MunetModel(const char* fnbin,const char* fnparam,const char* fnmsk,const NcnnPrec& prec = NcnnPrec());
+        //models already in memory, e.g. decrypted by gaes_decrypt
+        MunetModel(std::vector<char> bin,std::vector<char> param,std::vector<char> msk,const NcnnPrec& prec = NcnnPrec());
+        //weights and mask mapped read only, ncnn references the mapped pages
+        //instead of copying them; create_pipeline still repacks most conv
+        //weights into private memory, so only what it leaves is shared
+        MunetModel(std::shared_ptr<JMap> bin,std::vector<char> param,std::shared_ptr<JMap> msk,const NcnnPrec& prec = NcnnPrec());
+        ~MunetModel();
+};
+
+//per session side of the munet, every inference runs on its own extractor
+//of the shared model, nothing here is shared between sessions
+class Mobunet{
+    public:
+        //sees the inputs of every domodel before inference, e.g. to collect
+        //calibration samples; set it before any session renders
+        typedef std::function<void(JMat* pic,JMat* msk,JMat* feat)> MunetTap;
+        static void settap(const MunetTap& tap){s_tap = tap;};
+    private:
+        static MunetTap s_tap;
+        std::shared_ptr<MunetModel> m_model;
+        float mean_vals[3] = {127.5f, 127.5f, 127.5f};
+        float norm_vals[3] = {1 / 127.5f, 1 / 127.5f, 1 / 127.5f};
     public:
-        int domodel(JMat* pic,JMat* msk,JMat* feat);
+        //normalized 6 channel "face" input of the net, the real face over the masked one;
+        //msk NULL masks the standard mouth box of pic itself
+        int input(JMat* pic,JMat* msk,ncnn::Mat& inpic);
+        //threads>0 overrides the net's thread count for this inference,
+        //callers running several inferences at once split the cores
+        int domodel(JMat* pic,JMat* msk,JMat* feat,int threads = 0);
+        //count frames at once: ncnn has no batch axis, so the batch runs as
+        //count extractors side by side sharing threads (0: all big cores);
+        //returns the first non-zero result of any frame
+        int domodels(JMat** pics,JMat** msks,JMat** feats,int count,int threads = 0);
         int domodelold(JMat* pic,JMat* msk,JMat* feat);
         int preprocess(JMat* pic,JMat* feat);
         int process(JMat* pic,const int* boxs,JMat* feat);
         int fgprocess(JMat* pic,const int* boxs,JMat* feat,JMat* fg);
         int process2(JMat* pic,const int* boxs,JMat* feat);
-        Mobunet(const char* modeldir,const char* modelid);
-        Mobunet(const char* fnbin,const char* fnparam,const char* fnmsk);
+        MunetModel* model(){return m_model.get();};
+        std::shared_ptr<MunetModel> shared(){return m_model;};
+        explicit Mobunet(std::shared_ptr<MunetModel> model);
+        //standalone net, loads a model of its own
+        Mobunet(const char* modeldir,const char* modelid,const NcnnPrec& prec = NcnnPrec());
+        Mobunet(const char* fnbin,const char* fnparam,const char* fnmsk,const NcnnPrec& prec = NcnnPrec());
         ~Mobunet();
 };
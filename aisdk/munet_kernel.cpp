@@ -0,0 +1,326 @@
+#include "munet_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MKERN_SSSE3_TARGET __attribute__((target("ssse3")))
+#define MKERN_AVX2_TARGET __attribute__((target("avx2,fma")))
+#define MKERN_AVX512_TARGET __attribute__((target("avx512f,avx2,fma")))
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+const int munet_maskbox[4] = {5,5,150,145};
+
+//ncnn's substract_mean_normalize runs v*norm+bias, keep the same rounding
+static const float mkern_norm = 1/127.5f;
+static const float mkern_bias = -127.5f*(1/127.5f);
+//output side: (v+1)*127.5 as v*scale+scale
+static const float mkern_scale = 127.5f;
+
+//planes of one row: 0-2 real rgb, 3-5 masked rgb
+typedef void (*inrow_fn)(const uint8_t* s,int x,int n,float** out,int x0,int x1);
+
+//columns x..n-1, s at column x; masked planes are black in [x0,x1)
+static void inrow_c(const uint8_t* s,int x,int n,float** out,int x0,int x1){
+    for(;x<n;x++){
+        float b = s[0]*mkern_norm+mkern_bias;
+        float g = s[1]*mkern_norm+mkern_bias;
+        float r = s[2]*mkern_norm+mkern_bias;
+        out[0][x] = r;
+        out[1][x] = g;
+        out[2][x] = b;
+        int in = x>=x0&&x<x1;
+        out[3][x] = in?mkern_bias:r;
+        out[4][x] = in?mkern_bias:g;
+        out[5][x] = in?mkern_bias:b;
+        s += 3;
+    }
+}
+
+#ifdef MKERN_AVX2_TARGET
+static int avx2_supported(){
+    static int support = -1;
+    if(support<0){
+        __builtin_cpu_init();
+        support = __builtin_cpu_supports("avx2")&&__builtin_cpu_supports("fma")?1:0;
+    }
+    return support;
+}
+
+static int avx512_supported(){
+    static int support = -1;
+    if(support<0){
+        __builtin_cpu_init();
+        support = avx2_supported()&&__builtin_cpu_supports("avx512f")?1:0;
+    }
+    return support;
+}
+
+//8 pixels a step: 24 bytes split into b g r with two shuffles each
+MKERN_AVX2_TARGET static void inrow_avx2(const uint8_t* s,int x,int n,float** out,int x0,int x1){
+    const __m128i blo = _mm_setr_epi8(0,3,6,9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i bhi = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,2,5,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i glo = _mm_setr_epi8(1,4,7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i ghi = _mm_setr_epi8(-1,-1,-1,-1,-1,0,3,6,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i rlo = _mm_setr_epi8(2,5,8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i rhi = _mm_setr_epi8(-1,-1,-1,-1,-1,1,4,7,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m256 norm = _mm256_set1_ps(mkern_norm);
+    const __m256 bias = _mm256_set1_ps(mkern_bias);
+    const __m256i lane = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+    const __m256i lo = _mm256_set1_epi32(x0-1);
+    const __m256i hi = _mm256_set1_epi32(x1);
+    for(;x+8<=n;x+=8){
+        __m128i p0 = _mm_loadu_si128((const __m128i*)s);
+        __m128i p1 = _mm_loadl_epi64((const __m128i*)(s+16));
+        __m128i b8 = _mm_or_si128(_mm_shuffle_epi8(p0,blo),_mm_shuffle_epi8(p1,bhi));
+        __m128i g8 = _mm_or_si128(_mm_shuffle_epi8(p0,glo),_mm_shuffle_epi8(p1,ghi));
+        __m128i r8 = _mm_or_si128(_mm_shuffle_epi8(p0,rlo),_mm_shuffle_epi8(p1,rhi));
+        __m256 b = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b8)),norm,bias);
+        __m256 g = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(g8)),norm,bias);
+        __m256 r = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(r8)),norm,bias);
+        _mm256_storeu_ps(out[0]+x,r);
+        _mm256_storeu_ps(out[1]+x,g);
+        _mm256_storeu_ps(out[2]+x,b);
+        //lanes inside [x0,x1) take the black of the mask
+        __m256i idx = _mm256_add_epi32(lane,_mm256_set1_epi32(x));
+        __m256 in = _mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(idx,lo),_mm256_cmpgt_epi32(hi,idx)));
+        _mm256_storeu_ps(out[3]+x,_mm256_blendv_ps(r,bias,in));
+        _mm256_storeu_ps(out[4]+x,_mm256_blendv_ps(g,bias,in));
+        _mm256_storeu_ps(out[5]+x,_mm256_blendv_ps(b,bias,in));
+        s += 24;
+    }
+    inrow_c(s,x,n,out,x0,x1);
+}
+#endif
+
+#if defined(__ARM_NEON) && !defined(MKERN_AVX2_TARGET)
+static inline float32x4_t inrow_neon_norm(uint16x4_t v,float32x4_t norm,float32x4_t bias){
+    return vmlaq_f32(bias,vcvtq_f32_u32(vmovl_u16(v)),norm);
+}
+
+static void inrow_neon(const uint8_t* s,int x,int n,float** out,int x0,int x1){
+    const float32x4_t norm = vdupq_n_f32(mkern_norm);
+    const float32x4_t bias = vdupq_n_f32(mkern_bias);
+    const int32_t lanes[4] = {0,1,2,3};
+    const int32x4_t lane = vld1q_s32(lanes);
+    const int32x4_t lo = vdupq_n_s32(x0);
+    const int32x4_t hi = vdupq_n_s32(x1);
+    for(;x+8<=n;x+=8){
+        uint8x8x3_t p = vld3_u8(s);
+        uint16x8_t b16 = vmovl_u8(p.val[0]);
+        uint16x8_t g16 = vmovl_u8(p.val[1]);
+        uint16x8_t r16 = vmovl_u8(p.val[2]);
+        for(int h=0;h<2;h++){
+            int k = x+h*4;
+            float32x4_t b = inrow_neon_norm(h?vget_high_u16(b16):vget_low_u16(b16),norm,bias);
+            float32x4_t g = inrow_neon_norm(h?vget_high_u16(g16):vget_low_u16(g16),norm,bias);
+            float32x4_t r = inrow_neon_norm(h?vget_high_u16(r16):vget_low_u16(r16),norm,bias);
+            vst1q_f32(out[0]+k,r);
+            vst1q_f32(out[1]+k,g);
+            vst1q_f32(out[2]+k,b);
+            int32x4_t idx = vaddq_s32(lane,vdupq_n_s32(k));
+            uint32x4_t in = vandq_u32(vcgeq_s32(idx,lo),vcltq_s32(idx,hi));
+            vst1q_f32(out[3]+k,vbslq_f32(in,bias,r));
+            vst1q_f32(out[4]+k,vbslq_f32(in,bias,g));
+            vst1q_f32(out[5]+k,vbslq_f32(in,bias,b));
+        }
+        s += 24;
+    }
+    inrow_c(s,x,n,out,x0,x1);
+}
+#endif
+
+//one row of the output blend: p the r g b plane rows, w the weight row,
+//d the BGR row; columns x..n-1
+typedef void (*outrow_fn)(const float** p,int x,int n,const uint8_t* w,uint8_t* d);
+
+static inline uint8_t outpix(float v){
+    int s = (int)(v*mkern_scale+mkern_scale);
+    return s<0?0:(s>255?255:s);
+}
+
+static void outrow_c(const float** p,int x,int n,const uint8_t* w,uint8_t* d){
+    for(;x<n;x++){
+        int o = w[x];
+        uint8_t* px = d+3*x;
+        //BlendGramAlpha's ChannelBlend_AlphaEx, source planes are rgb
+        px[0] = (o*px[0]+(255-o)*outpix(p[2][x]))/255;
+        px[1] = (o*px[1]+(255-o)*outpix(p[1][x]))/255;
+        px[2] = (o*px[2]+(255-o)*outpix(p[0][x]))/255;
+    }
+}
+
+#ifdef MKERN_AVX2_TARGET
+//pshufb masks between 16 packed BGR pixels (48 bytes) and b g r planes:
+//mkern_split[channel][source register], mkern_merge[dest register][channel]
+static uint8_t mkern_split[3][3][16];
+static uint8_t mkern_merge[3][3][16];
+
+static void init_shuffles(){
+    for(int c=0;c<3;c++){
+        for(int k=0;k<3;k++){
+            for(int j=0;j<16;j++){
+                int pos = 3*j+c;
+                mkern_split[c][k][j] = pos/16==k?pos%16:0x80;
+                pos = 16*k+j;
+                mkern_merge[k][c][j] = pos%3==c?pos/3:0x80;
+            }
+        }
+    }
+}
+
+MKERN_SSSE3_TARGET static inline void split16(const uint8_t* d,__m128i* bgr){
+    __m128i p[3];
+    for(int k=0;k<3;k++)p[k] = _mm_loadu_si128((const __m128i*)(d+16*k));
+    for(int c=0;c<3;c++){
+        __m128i v = _mm_shuffle_epi8(p[0],_mm_loadu_si128((const __m128i*)mkern_split[c][0]));
+        v = _mm_or_si128(v,_mm_shuffle_epi8(p[1],_mm_loadu_si128((const __m128i*)mkern_split[c][1])));
+        bgr[c] = _mm_or_si128(v,_mm_shuffle_epi8(p[2],_mm_loadu_si128((const __m128i*)mkern_split[c][2])));
+    }
+}
+
+MKERN_SSSE3_TARGET static inline void merge16(uint8_t* d,const __m128i* bgr){
+    for(int k=0;k<3;k++){
+        __m128i v = _mm_shuffle_epi8(bgr[0],_mm_loadu_si128((const __m128i*)mkern_merge[k][0]));
+        v = _mm_or_si128(v,_mm_shuffle_epi8(bgr[1],_mm_loadu_si128((const __m128i*)mkern_merge[k][1])));
+        v = _mm_or_si128(v,_mm_shuffle_epi8(bgr[2],_mm_loadu_si128((const __m128i*)mkern_merge[k][2])));
+        _mm_storeu_si128((__m128i*)(d+16*k),v);
+    }
+}
+
+//16 pixels a step, blend in 16 bit lanes: 255*255 and the /255 rounding fit
+MKERN_AVX2_TARGET static void outrow_avx2(const float** p,int x,int n,const uint8_t* w,uint8_t* d){
+    const __m256 scale = _mm256_set1_ps(mkern_scale);
+    const __m256i max8 = _mm256_set1_epi16(255);
+    const __m256i one = _mm256_set1_epi16(1);
+    for(;x+16<=n;x+=16){
+        __m128i bgr[3];
+        split16(d+3*x,bgr);
+        __m256i o = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(w+x)));
+        __m256i io = _mm256_sub_epi16(max8,o);
+        for(int c=0;c<3;c++){
+            const float* src = p[2-c]+x;
+            __m256i lo = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_loadu_ps(src),scale,scale));
+            __m256i hi = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_loadu_ps(src+8),scale,scale));
+            //packus interleaves the 128 bit halves, put them back in order
+            __m256i s = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo,hi),0xd8);
+            s = _mm256_min_epu16(s,max8);
+            __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(o,_mm256_cvtepu8_epi16(bgr[c])),_mm256_mullo_epi16(io,s));
+            //exact v/255 for v<=255*255
+            v = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(v,one),_mm256_srli_epi16(v,8)),8);
+            bgr[c] = _mm_packus_epi16(_mm256_castsi256_si128(v),_mm256_extracti128_si256(v,1));
+        }
+        merge16(d+3*x,bgr);
+    }
+    outrow_c(p,x,n,w,d);
+}
+
+//same with 16 float lanes and the blend in 32 bit;
+//gcc 12's unmasked avx512 intrinsics pass _mm512_undefined_epi32() as the
+//pass-through operand and -Wmaybe-uninitialized flags it once inlined here
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+MKERN_AVX512_TARGET static void outrow_avx512(const float** p,int x,int n,const uint8_t* w,uint8_t* d){
+    const __m512 scale = _mm512_set1_ps(mkern_scale);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i max8 = _mm512_set1_epi32(255);
+    const __m512i one = _mm512_set1_epi32(1);
+    for(;x+16<=n;x+=16){
+        __m128i bgr[3];
+        split16(d+3*x,bgr);
+        __m512i o = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(w+x)));
+        __m512i io = _mm512_sub_epi32(max8,o);
+        for(int c=0;c<3;c++){
+            __m512i s = _mm512_cvttps_epi32(_mm512_fmadd_ps(_mm512_loadu_ps(p[2-c]+x),scale,scale));
+            s = _mm512_min_epi32(_mm512_max_epi32(s,zero),max8);
+            __m512i v = _mm512_add_epi32(_mm512_mullo_epi32(o,_mm512_cvtepu8_epi32(bgr[c])),_mm512_mullo_epi32(io,s));
+            v = _mm512_srli_epi32(_mm512_add_epi32(_mm512_add_epi32(v,one),_mm512_srli_epi32(v,8)),8);
+            bgr[c] = _mm512_cvtepi32_epi8(v);
+        }
+        merge16(d+3*x,bgr);
+    }
+    outrow_c(p,x,n,w,d);
+}
+#pragma GCC diagnostic pop
+#endif
+
+#if defined(__ARM_NEON) && !defined(MKERN_AVX2_TARGET)
+static void outrow_neon(const float** p,int x,int n,const uint8_t* w,uint8_t* d){
+    const float32x4_t scale = vdupq_n_f32(mkern_scale);
+    const uint16x8_t one = vdupq_n_u16(1);
+    for(;x+8<=n;x+=8){
+        uint8x8x3_t px = vld3_u8(d+3*x);
+        uint8x8_t o = vld1_u8(w+x);
+        uint8x8_t io = vsub_u8(vdup_n_u8(255),o);
+        for(int c=0;c<3;c++){
+            const float* src = p[2-c]+x;
+            //float to u32 truncates and saturates negatives to 0
+            uint32x4_t lo = vcvtq_u32_f32(vmlaq_f32(scale,vld1q_f32(src),scale));
+            uint32x4_t hi = vcvtq_u32_f32(vmlaq_f32(scale,vld1q_f32(src+4),scale));
+            uint8x8_t s = vqmovn_u16(vcombine_u16(vqmovn_u32(lo),vqmovn_u32(hi)));
+            uint16x8_t v = vmlal_u8(vmull_u8(o,px.val[c]),io,s);
+            v = vshrq_n_u16(vaddq_u16(vaddq_u16(v,one),vshrq_n_u16(v,8)),8);
+            px.val[c] = vmovn_u16(v);
+        }
+        vst3_u8(d+3*x,px);
+    }
+    outrow_c(p,x,n,w,d);
+}
+#endif
+
+static void output_rows(outrow_fn fn,const float* src,size_t cstep,const uint8_t* weight,uint8_t* dst,int stride){
+    const float* p[3];
+    for(int y=0;y<MUNET_SIZE;y++){
+        for(int k=0;k<3;k++)p[k] = src+k*cstep+y*MUNET_SIZE;
+        fn(p,0,MUNET_SIZE,weight+y*MUNET_SIZE,dst+(size_t)y*stride);
+    }
+}
+
+static outrow_fn pick_outrow(){
+#ifdef MKERN_AVX2_TARGET
+    init_shuffles();
+    if(avx512_supported())return outrow_avx512;
+    if(avx2_supported())return outrow_avx2;
+#elif defined(__ARM_NEON)
+    return outrow_neon;
+#endif
+    return outrow_c;
+}
+
+static void input_rows(inrow_fn fn,const uint8_t* src,int stride,const int* box,float* dst,size_t cstep){
+    float* out[6];
+    for(int y=0;y<MUNET_SIZE;y++){
+        for(int k=0;k<6;k++)out[k] = dst+k*cstep+y*MUNET_SIZE;
+        int inbox = box&&y>=box[1]&&y<box[1]+box[3];
+        int x0 = inbox?box[0]:0;
+        int x1 = inbox?box[0]+box[2]:0;
+        fn(src+(size_t)y*stride,0,MUNET_SIZE,out,x0,x1);
+    }
+}
+
+static inrow_fn pick_inrow(){
+#ifdef MKERN_AVX2_TARGET
+    if(avx2_supported())return inrow_avx2;
+#elif defined(__ARM_NEON)
+    return inrow_neon;
+#endif
+    return inrow_c;
+}
+
+void munet_input(const uint8_t* src,int stride,const int* box,float* dst,size_t cstep){
+    static inrow_fn fn = pick_inrow();
+    input_rows(fn,src,stride,box,dst,cstep);
+}
+
+void munet_input_c(const uint8_t* src,int stride,const int* box,float* dst,size_t cstep){
+    input_rows(inrow_c,src,stride,box,dst,cstep);
+}
+
+void munet_output(const float* src,size_t cstep,const uint8_t* weight,uint8_t* dst,int stride){
+    static outrow_fn fn = pick_outrow();
+    output_rows(fn,src,cstep,weight,dst,stride);
+}
+
+void munet_output_c(const float* src,size_t cstep,const uint8_t* weight,uint8_t* dst,int stride){
+    output_rows(outrow_c,src,cstep,weight,dst,stride);
+}
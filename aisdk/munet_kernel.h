@@ -0,0 +1,35 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+//side of the munet face crop
+#define MUNET_SIZE      160
+
+//mouth box the net repaints, x y w h in the 160 crop
+extern const int munet_maskbox[4];
+
+/*
+ * munet "face" input straight from the BGR crop in one pass: planes 0-2
+ * the real face in RGB, planes 3-5 the same face with box at black, all
+ * normalized to (v-127.5)/127.5. the masked planes come out of the same
+ * loads, the box is never filled in the source.
+ * src: 160x160 BGR rows stride bytes apart
+ * dst: 6 planes cstep floats apart, e.g. an ncnn::Mat(160,160,6)
+ * picks AVX2 or NEON when the cpu has it
+ * */
+void munet_input(const uint8_t* src,int stride,const int* box,float* dst,size_t cstep);
+//plain C version, reference for the vector ones
+void munet_input_c(const uint8_t* src,int stride,const int* box,float* dst,size_t cstep);
+
+/*
+ * munet output back into the face in one pass: the RGB planes of the net
+ * scaled to (v+1)*127.5, truncated and clamped to uint8, swapped to BGR
+ * and blended in fixed point as D = (W*D + (255-W)*S)/255, the same as
+ * to_pixels followed by BlendGramAlpha.
+ * src: 3 planes of 160x160 floats cstep apart, elempack 1
+ * weight: 160x160 blend mask, one byte a pixel
+ * dst: 160x160 BGR rows stride bytes apart, blended in place
+ * picks AVX-512, AVX2 or NEON when the cpu has it
+ * */
+void munet_output(const float* src,size_t cstep,const uint8_t* weight,uint8_t* dst,int stride);
+void munet_output_c(const float* src,size_t cstep,const uint8_t* weight,uint8_t* dst,int stride);
@@ -0,0 +1,175 @@
+#include "munetservice.h"
+#include "cpu.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+const int munetsvc_waitms[MUNETSVC_WAITS] = {1,2,5,10,20,40,80,0};
+
+MunetService::MunetService(){
+    memset(&m_stat,0,sizeof(m_stat));
+}
+
+MunetService::~MunetService(){
+    stop();
+}
+
+MunetService* MunetService::get(){
+    static MunetService service;
+    return &service;
+}
+
+int64_t MunetService::nowus(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int MunetService::init(int workers,int windowus,int maxbatch,int deadlinems){
+    std::unique_lock<std::mutex> lock(m_lock);
+    if(vec_worker.size())return -1;
+    if(workers<1)return 0;
+    m_threads = ncnn::get_big_cpu_count()/workers;
+    if(m_threads<1)m_threads = 1;
+    m_windowus = windowus<0?0:windowus;
+    m_maxbatch = maxbatch<1?1:maxbatch;
+    m_deadlineus = deadlinems*1000;
+    m_quit = 0;
+    m_stat.workers = workers;
+    m_stat.threads = m_threads;
+    for(int k=0;k<workers;k++){
+        vec_worker.push_back(new std::thread(&MunetService::work,this));
+    }
+    m_running = true;
+    printf("===munet service workers %d threads %d window %dus batch %d\n",workers,m_threads,m_windowus,m_maxbatch);
+    return 0;
+}
+
+void MunetService::stop(){
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_running = false;
+    m_quit = 1;
+    lock.unlock();
+    m_cond.notify_all();
+    for(auto th:vec_worker){
+        th->join();
+        delete th;
+    }
+    lock.lock();
+    vec_worker.clear();
+    for(auto& kv:map_queue){
+        for(auto req:kv.second->reqs){
+            req->done.set_value(-1);
+            delete req;
+        }
+    }
+    map_queue.clear();
+}
+
+std::future<int> MunetService::submit(std::shared_ptr<MunetModel> model,JMat* pic,JMat* msk,JMat* feat,int64_t deadline){
+    Req* req = new Req();
+    req->pic = pic;
+    req->msk = msk;
+    req->feat = feat;
+    req->submitted = nowus();
+    req->deadline = deadline?deadline:req->submitted+m_deadlineus;
+    std::future<int> fut = req->done.get_future();
+    std::unique_lock<std::mutex> lock(m_lock);
+    if(m_quit||!vec_worker.size()){
+        lock.unlock();
+        req->done.set_value(-1);
+        delete req;
+        return fut;
+    }
+    QueuePtr& queue = map_queue[model.get()];
+    if(!queue){
+        queue = std::make_shared<Queue>();
+        queue->model = model;
+        queue->net = new Mobunet(model);
+    }
+    queue->reqs.push_back(req);
+    m_stat.pending++;
+    lock.unlock();
+    m_cond.notify_one();
+    return fut;
+}
+
+int MunetService::run(std::shared_ptr<MunetModel> model,JMat* pic,JMat* msk,JMat* feat){
+    return submit(model,pic,msk,feat).get();
+}
+
+//queue whose head waited longest, due is when it has to start;
+//drops the idle queues of models no session holds anymore
+MunetService::QueuePtr MunetService::pick(int64_t now,int64_t* due){
+    QueuePtr best;
+    for(auto it=map_queue.begin();it!=map_queue.end();){
+        QueuePtr& queue = it->second;
+        if(!queue->reqs.size()){
+            if(queue->model.use_count()<=2)it = map_queue.erase(it);
+            else it++;
+            continue;
+        }
+        it++;
+        if(!best||queue->reqs.front()->submitted<best->reqs.front()->submitted)best = queue;
+    }
+    if(!best)return best;
+    Req* head = best->reqs.front();
+    int64_t start = head->submitted+m_windowus;
+    //leave room to run the whole batch before the head's deadline
+    int64_t latest = head->deadline-(int64_t)(m_costus*(best->reqs.size()+1));
+    *due = start<latest?start:latest;
+    return best;
+}
+
+void MunetService::work(){
+    std::unique_lock<std::mutex> lock(m_lock);
+    std::vector<Req*> batch;
+    while(!m_quit){
+        int64_t now = nowus();
+        int64_t due = 0;
+        QueuePtr queue = pick(now,&due);
+        if(!queue){
+            m_cond.wait(lock);
+            continue;
+        }
+        if((int)queue->reqs.size()<m_maxbatch&&now<due){
+            m_cond.wait_for(lock,std::chrono::microseconds(due-now));
+            continue;
+        }
+        batch.clear();
+        while(queue->reqs.size()&&(int)batch.size()<m_maxbatch){
+            batch.push_back(queue->reqs.front());
+            queue->reqs.pop_front();
+        }
+        m_stat.pending -= batch.size();
+        m_stat.batches++;
+        m_stat.batchhist[batch.size()<MUNETSVC_BATCHES?batch.size():MUNETSVC_BATCHES]++;
+        for(auto req:batch){
+            int64_t waitms = (now-req->submitted)/1000;
+            int k = 0;
+            while(k<MUNETSVC_WAITS-1&&waitms>=munetsvc_waitms[k])k++;
+            m_stat.waithist[k]++;
+        }
+        lock.unlock();
+        //other queued requests can start on the idle workers meanwhile
+        m_cond.notify_one();
+        for(auto req:batch){
+            int64_t t0 = nowus();
+            int rst = queue->net->domodel(req->pic,req->msk,req->feat,m_threads);
+            int64_t t1 = nowus();
+            lock.lock();
+            m_costus = m_costus?m_costus*0.9+(t1-t0)*0.1:(t1-t0);
+            m_stat.requests++;
+            if(t1>req->deadline)m_stat.misses++;
+            lock.unlock();
+            req->done.set_value(rst);
+            delete req;
+        }
+        lock.lock();
+    }
+}
+
+void MunetService::stat(munetsvc_stat* st){
+    std::unique_lock<std::mutex> lock(m_lock);
+    memcpy(st,&m_stat,sizeof(munetsvc_stat));
+    st->avgcost = m_costus/1000.0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "munet.h"
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//largest batch the histogram tracks, bigger batches count in the last slot
+#define MUNETSVC_BATCHES    16
+//queue wait buckets, upper bounds in ms, the last one is open
+#define MUNETSVC_WAITS      8
+
+typedef struct _munetsvc_stat{
+    int         workers;
+    int         threads;        //ncnn threads of each worker
+    uint64_t    requests;
+    uint64_t    batches;
+    uint64_t    misses;         //requests finished after their deadline
+    uint64_t    pending;
+    //batchhist[n]: batches of n requests, slot 0 unused
+    uint64_t    batchhist[MUNETSVC_BATCHES+1];
+    //waithist[k]: requests that waited below munetsvc_waitms[k]
+    uint64_t    waithist[MUNETSVC_WAITS];
+    double      avgcost;        //ms of one inference, moving average
+}munetsvc_stat;
+
+extern const int munetsvc_waitms[MUNETSVC_WAITS];
+
+/*
+ * host wide munet inference
+ *
+ * sessions submit (face, mask, feature, deadline) instead of running their
+ * own extractor on their own ncnn thread team. requests queue per model;
+ * a fixed pool of workers, each with big_cpu/workers threads, takes the
+ * oldest model's queue once it holds maxbatch requests, the window since
+ * its oldest request ran out, or waiting longer would miss that request's
+ * deadline, and runs the batch back to back on the same weights.
+ * a model keeps its queue and extractor while any session still holds it.
+ * */
+class MunetService{
+    private:
+        struct Req{
+            JMat*       pic;
+            JMat*       msk;
+            JMat*       feat;
+            int64_t     submitted;  //us, steady clock
+            int64_t     deadline;
+            std::promise<int>   done;
+        };
+        //model is held here and by net, no one else holding it means idle for good
+        struct Queue{
+            std::shared_ptr<MunetModel> model;
+            Mobunet*            net = nullptr;
+            std::deque<Req*>    reqs;
+            ~Queue(){if(net)delete net;};
+        };
+        typedef std::shared_ptr<Queue> QueuePtr;
+
+        std::mutex      m_lock;
+        std::condition_variable m_cond;
+        std::map<MunetModel*,QueuePtr>  map_queue;
+        std::vector<std::thread*>       vec_worker;
+        std::atomic<bool>   m_running{false};
+        int             m_quit = 0;
+        int             m_threads = 1;
+        int             m_windowus = 0;
+        int             m_maxbatch = 1;
+        int             m_deadlineus = 0;
+        //us of one inference, moving average, sizes the deadline slack
+        double          m_costus = 0;
+        munetsvc_stat   m_stat;
+
+        MunetService();
+        void    work();
+        QueuePtr    pick(int64_t now,int64_t* due);
+    public:
+        static MunetService* get();
+        //workers 0 leaves the service off, sessions infer on their own threads
+        int     init(int workers,int windowus,int maxbatch,int deadlinems);
+        int     running(){return m_running.load();};
+        //deadline: steady clock us, 0 for now + the default deadline
+        std::future<int>    submit(std::shared_ptr<MunetModel> model,JMat* pic,JMat* msk,JMat* feat,int64_t deadline = 0);
+        //submit and wait
+        int     run(std::shared_ptr<MunetModel> model,JMat* pic,JMat* msk,JMat* feat);
+        void    stat(munetsvc_stat* st);
+        void    stop();
+        static int64_t  nowus();
+        ~MunetService();
+};
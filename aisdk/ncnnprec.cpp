@@ -0,0 +1,38 @@
+#include "ncnnprec.h"
+#include <string.h>
+
+int ncnnprec_parse(const char* name){
+    if(!name||!strlen(name))return NCNN_PREC_DEF;
+    if(!strcmp(name,"fp32"))return NCNN_PREC_FP32;
+    if(!strcmp(name,"fp16"))return NCNN_PREC_FP16;
+    if(!strcmp(name,"bf16"))return NCNN_PREC_BF16;
+    return NCNN_PREC_DEF;
+}
+
+int ncnnprec_known(const char* name){
+    if(!name||!strlen(name))return 1;
+    return ncnnprec_parse(name)!=NCNN_PREC_DEF;
+}
+
+const char* ncnnprec_name(int prec){
+    switch(prec){
+        case NCNN_PREC_FP32:return "fp32";
+        case NCNN_PREC_FP16:return "fp16";
+        case NCNN_PREC_BF16:return "bf16";
+    }
+    return "default";
+}
+
+void ncnnprec_apply(ncnn::Option& opt,const NcnnPrec& prec){
+    if(prec.storage!=NCNN_PREC_DEF){
+        opt.use_fp16_packed = prec.storage==NCNN_PREC_FP16;
+        opt.use_fp16_storage = prec.storage==NCNN_PREC_FP16;
+        opt.use_bf16_storage = prec.storage==NCNN_PREC_BF16;
+    }
+    if(prec.arith!=NCNN_PREC_DEF){
+        //ncnn has no bf16 math, bf16 storage computes in fp32 either way;
+        //fp16 math only takes effect on fp16 storage
+        opt.use_fp16_arithmetic = prec.arith==NCNN_PREC_FP16;
+    }
+    if(prec.flat)opt.use_packing_layout = false;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "net.h"
+
+//precision of an ncnn model: storage is how weights and blobs are kept in
+//memory, arith what the layers compute in
+#define NCNN_PREC_DEF   -1      //keep ncnn's default for the cpu
+#define NCNN_PREC_FP32  0
+#define NCNN_PREC_FP16  1
+#define NCNN_PREC_BF16  2
+
+struct NcnnPrec{
+    int     storage = NCNN_PREC_DEF;
+    int     arith = NCNN_PREC_DEF;
+    //1 keeps blobs at elempack 1 instead of the simd packed layout
+    int     flat = 0;
+};
+
+//"fp32","fp16","bf16"; NCNN_PREC_DEF for null, empty or unknown names
+int         ncnnprec_parse(const char* name);
+//0 for a name ncnnprec_parse would silently drop to NCNN_PREC_DEF
+int         ncnnprec_known(const char* name);
+const char* ncnnprec_name(int prec);
+//set before load_param, ncnn converts the weights while it loads them
+void        ncnnprec_apply(ncnn::Option& opt,const NcnnPrec& prec);
@@ -0,0 +1,179 @@
+#include "roleface.h"
+#include "jmat.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+static int packstamp(const char* packfn,uint64_t* psize,int64_t* pmtime){
+    struct stat st;
+    if(stat(packfn,&st)<0)return -1;
+    *psize = st.st_size;
+    *pmtime = (int64_t)st.st_mtim.tv_sec*1000000000ll+st.st_mtim.tv_nsec;
+    return 0;
+}
+
+RoleFaces::RoleFaces(){
+}
+
+RoleFaces::~RoleFaces(){
+    close();
+}
+
+int RoleFaces::open(const char* facefn,const char* packfn){
+    close();
+    uint64_t packsize = 0;
+    int64_t packmtime = 0;
+    if(packstamp(packfn,&packsize,&packmtime))return -1;
+    int fd = ::open(facefn,O_RDONLY);
+    if(fd<0)return -2;
+    struct stat st;
+    if(fstat(fd,&st)<0||(uint64_t)st.st_size<sizeof(gfc_hdr)){
+        ::close(fd);
+        return -3;
+    }
+    void* map = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    if(map==MAP_FAILED){
+        ::close(fd);
+        return -4;
+    }
+    m_fd = fd;
+    m_map = (uint8_t*)map;
+    m_mapsize = st.st_size;
+    m_hdr = (gfc_hdr*)m_map;
+    char* arr = m_hdr->head;
+    int rst = 0;
+    while(1){
+        if((arr[0]!='g')||(arr[1]!='f')||(arr[2]!='c')){
+            rst = -11;
+            break;
+        }
+        if(m_hdr->version!=GFC_VERSION||m_hdr->side!=GFC_SIDE){
+            rst = -12;
+            break;
+        }
+        if(m_hdr->packsize!=packsize||m_hdr->packmtime!=packmtime){
+            rst = -13;
+            break;
+        }
+        uint64_t frames = m_hdr->frames;
+        if(m_hdr->itemoff+frames*sizeof(gfc_item)>m_mapsize){
+            rst = -14;
+            break;
+        }
+        m_items = (gfc_item*)(m_map+m_hdr->itemoff);
+        break;
+    }
+    if(rst){
+        close();
+    }
+    return rst;
+}
+
+void RoleFaces::close(){
+    if(m_map){
+        munmap(m_map,m_mapsize);
+        m_map = nullptr;
+    }
+    if(m_fd>=0){
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_mapsize = 0;
+    m_hdr = nullptr;
+    m_items = nullptr;
+}
+
+int RoleFaces::frames(){
+    return m_hdr?m_hdr->frames:0;
+}
+
+const uint8_t* RoleFaces::face(int inx,const int* box){
+    if(inx<0||inx>=frames()||!box)return NULL;
+    gfc_item* item = m_items+inx;
+    if(!item->off||item->off+GFC_FACESIZE>m_mapsize)return NULL;
+    if(memcmp(item->box,box,sizeof(item->box)))return NULL;
+    return m_map+item->off;
+}
+
+static int writeall(int fd,const void* buf,size_t size,uint64_t off){
+    size_t done = 0;
+    while(done<size){
+        ssize_t n = pwrite(fd,(const uint8_t*)buf+done,size-done,off+done);
+        if(n<=0)return -1;
+        done += n;
+    }
+    return 0;
+}
+
+//face of one frame as MWorkMat::premunet cuts it
+static int compileface(RolePack* pack,int inx,const int* box,uint8_t* face){
+    const uint8_t* buf = NULL;
+    uint32_t size = 0;
+    if(pack->plane(inx,GPK_RAW,&buf,&size))return -1;
+    JMat pic;
+    if(pic.loadjpg(buf,size))return -2;
+    int w = box[2]-box[0];
+    int h = box[3]-box[1];
+    if(box[0]<0||box[1]<0||w<=0||h<=0||box[2]>pic.width()||box[3]>pic.height())return -3;
+    cv::Mat roi(pic.cvmat(),cv::Rect(box[0],box[1],w,h));
+    cv::Mat dst(GFC_SIDE,GFC_SIDE,CV_8UC3,face);
+    cv::resize(roi,dst,cv::Size(GFC_SIDE,GFC_SIDE),cv::INTER_AREA);
+    return 0;
+}
+
+int roleface_compile(RolePack* pack,const char* packfn,const char* facefn){
+    gfc_hdr hdr;
+    memset(&hdr,0,sizeof(gfc_hdr));
+    if(packstamp(packfn,&hdr.packsize,&hdr.packmtime))return -1;
+    //unique per writer, two processes may compile the same role at load
+    std::string tmpfn = std::string(facefn)+".XXXXXX";
+    int fd = mkstemp(tmpfn.data());
+    if(fd<0)return -2;
+    fchmod(fd,0644);
+    hdr.head[0]='g';
+    hdr.head[1]='f';
+    hdr.head[2]='c';
+    hdr.head[3]='1';
+    hdr.version = GFC_VERSION;
+    hdr.side = GFC_SIDE;
+    hdr.frames = pack->frames();
+    hdr.itemoff = sizeof(gfc_hdr);
+    std::vector<gfc_item> items(hdr.frames);
+    //faces start page aligned after the table
+    uint64_t off = hdr.itemoff+items.size()*sizeof(gfc_item);
+    off = (off+4095)&~4095ull;
+    std::vector<uint8_t> face(GFC_FACESIZE);
+    int rst = 0;
+    int done = 0;
+    for(int k=0;k<hdr.frames&&!rst;k++){
+        gfc_item& item = items[k];
+        memset(&item,0,sizeof(gfc_item));
+        const int* box = pack->box(k);
+        if(!box)continue;
+        memcpy(item.box,box,sizeof(item.box));
+        if(compileface(pack,k,box,face.data()))continue;
+        if(writeall(fd,face.data(),face.size(),off)){
+            rst = -3;
+            break;
+        }
+        item.off = off;
+        off += face.size();
+        done++;
+    }
+    if(!rst&&items.size()&&writeall(fd,items.data(),items.size()*sizeof(gfc_item),hdr.itemoff))rst = -4;
+    if(!rst&&writeall(fd,&hdr,sizeof(gfc_hdr),0))rst = -5;
+    //data on disk before the name, a crash never leaves a torn file in place
+    if(!rst&&fsync(fd))rst = -8;
+    if(::close(fd)&&!rst)rst = -6;
+    if(!rst&&rename(tmpfn.c_str(),facefn))rst = -7;
+    if(rst){
+        unlink(tmpfn.c_str());
+        return rst;
+    }
+    return done;
+}
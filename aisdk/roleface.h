@@ -0,0 +1,68 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include "rolepack.h"
+
+/*
+ * compiled role faces (.gfc), the audio independent half of the munet
+ * input of every pack frame, built once beside frames.gpk
+ *
+ *   gfc_hdr                     fixed header, stamp of the pack it came from
+ *   gfc_item * frames           box each face was cut from, its offset
+ *   faces ...                   168x168 BGR, INTER_AREA resize of the box
+ *
+ * the speaking path copies a face instead of decoding, cropping and
+ * resizing the frame; MWorkMat/munet_input build the normalized real and
+ * masked planes from it in one pass. the float planes themselves are not
+ * stored, at 600KB a frame reading them back costs more than that pass.
+ * */
+extern "C"{
+#pragma pack(push)
+#pragma pack(4)
+
+    typedef struct _gfc_hdr {
+        char        head[4];
+        int         version;
+        int         frames;
+        int         side;
+        //pack the faces were compiled from, size and mtime in ns
+        uint64_t    packsize;
+        int64_t     packmtime;
+        uint64_t    itemoff;
+        int         reserved[8];
+    }gfc_hdr;
+
+    typedef struct _gfc_item {
+        int         box[4];
+        uint64_t    off;        //0: frame has no usable box
+    }gfc_item;
+#pragma pack(pop)
+}
+
+#define GFC_VERSION 1
+#define GFC_SIDE    168
+#define GFC_FACESIZE    (GFC_SIDE*GFC_SIDE*3)
+
+class RoleFaces{
+    private:
+        int         m_fd = -1;
+        uint8_t*    m_map = nullptr;
+        uint64_t    m_mapsize = 0;
+        gfc_hdr*    m_hdr = nullptr;
+        gfc_item*   m_items = nullptr;
+    public:
+        //fails when the file is missing, of another version or stale against packfn
+        int open(const char* facefn,const char* packfn);
+        void close();
+        int frames();
+        //168 face of frame inx, NULL when it was not compiled for this box
+        const uint8_t* face(int inx,const int* box);
+        RoleFaces();
+        virtual ~RoleFaces();
+};
+
+//decode every raw plane of pack and write its faces to facefn,
+//through a unique temporary file so readers and concurrent compilers
+//never see half of it
+//return frames compiled
+int roleface_compile(RolePack* pack,const char* packfn,const char* facefn);
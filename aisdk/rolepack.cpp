@@ -0,0 +1,324 @@
+#include "rolepack.h"
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+RolePack::RolePack(){
+}
+
+RolePack::~RolePack(){
+    close();
+}
+
+int RolePack::open(const char* packfn){
+    close();
+    int fd = ::open(packfn,O_RDONLY);
+    if(fd<0)return -1;
+    struct stat st;
+    if(fstat(fd,&st)<0){
+        ::close(fd);
+        return -2;
+    }
+    uint64_t mapsize = st.st_size;
+    if(mapsize<sizeof(gpk_hdr)){
+        ::close(fd);
+        return -3;
+    }
+    void* map = mmap(NULL,mapsize,PROT_READ,MAP_SHARED,fd,0);
+    if(map==MAP_FAILED){
+        ::close(fd);
+        return -4;
+    }
+    m_fd = fd;
+    m_map = (uint8_t*)map;
+    m_mapsize = mapsize;
+    m_hdr = (gpk_hdr*)m_map;
+    char* arr = m_hdr->head;
+    int rst = 0;
+    while(1){
+        if((arr[0]!='g')||(arr[1]!='p')||(arr[2]!='k')){
+            rst = -11;
+            break;
+        }
+        if(m_hdr->version!=GPK_VERSION){
+            rst = -12;
+            break;
+        }
+        uint64_t frames = m_hdr->frames;
+        if((m_hdr->boxoff+frames*4*sizeof(int)>mapsize)||
+            (m_hdr->inxoff+frames*sizeof(gpk_inx)>mapsize)){
+            rst = -13;
+            break;
+        }
+        m_boxs = (int*)(m_map+m_hdr->boxoff);
+        m_inxs = (gpk_inx*)(m_map+m_hdr->inxoff);
+        break;
+    }
+    if(rst){
+        close();
+    }
+    return rst;
+}
+
+void RolePack::close(){
+    if(m_map){
+        munmap(m_map,m_mapsize);
+        m_map = nullptr;
+    }
+    if(m_fd>=0){
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_mapsize = 0;
+    m_hdr = nullptr;
+    m_boxs = nullptr;
+    m_inxs = nullptr;
+    m_live = nullptr;
+}
+
+int RolePack::openlive(RolePackWriter* writer){
+    close();
+    if(!writer||writer->m_packfn.empty()||!writer->m_capacity)return -1;
+    int fd = ::open(writer->m_packfn.c_str(),O_RDONLY);
+    if(fd<0)return -2;
+    //whole capacity is mapped now, payloads written later show up in place
+    void* map = mmap(NULL,writer->m_capacity,PROT_READ,MAP_SHARED,fd,0);
+    if(map==MAP_FAILED){
+        ::close(fd);
+        return -4;
+    }
+    m_fd = fd;
+    m_map = (uint8_t*)map;
+    m_mapsize = writer->m_capacity;
+    m_hdr = &writer->m_hdr;
+    m_boxs = writer->vec_box.data();
+    m_inxs = writer->vec_inx.data();
+    m_live = &writer->m_ready;
+    return 0;
+}
+
+int RolePack::frames(){
+    if(m_live)return m_live->load(std::memory_order_acquire);
+    return m_hdr?m_hdr->frames:0;
+}
+
+int RolePack::width(){
+    return m_hdr?m_hdr->width:0;
+}
+
+int RolePack::height(){
+    return m_hdr?m_hdr->height:0;
+}
+
+int RolePack::hasmask(){
+    return m_hdr?m_hdr->hasmask:0;
+}
+
+const int* RolePack::box(int inx){
+    if(inx<0||inx>=frames())return NULL;
+    return m_boxs+inx*4;
+}
+
+int RolePack::plane(int inx,int kind,const uint8_t** pbuf,uint32_t* psize){
+    if(inx<0||inx>=frames())return -1;
+    if(kind<0||kind>=GPK_PLANES)return -2;
+    gpk_inx* item = m_inxs+inx;
+    uint32_t size = item->size[kind];
+    if(!size)return -3;
+    if(item->off[kind]+size>m_mapsize)return -4;
+    *pbuf = m_map+item->off[kind];
+    *psize = size;
+    return 0;
+}
+
+int RolePack::extent(int inx,int kind,uint64_t* poff,uint32_t* psize){
+    if(inx<0||inx>=frames())return -1;
+    if(kind<0||kind>=GPK_PLANES)return -2;
+    gpk_inx* item = m_inxs+inx;
+    uint32_t size = item->size[kind];
+    if(!size)return -3;
+    if(item->off[kind]+size>m_mapsize)return -4;
+    *poff = item->off[kind];
+    *psize = size;
+    return 0;
+}
+
+RolePackWriter::RolePackWriter(){
+    memset(&m_hdr,0,sizeof(gpk_hdr));
+}
+
+RolePackWriter::~RolePackWriter(){
+    if(m_fd>=0){
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+int RolePackWriter::begin(const char* packfn,int width,int height,int hasmask){
+    if(m_fd>=0)return -1;
+    if((m_fd = ::open(packfn,O_RDWR|O_CREAT|O_TRUNC,0644))<0)return -2;
+    m_packfn = packfn;
+    memset(&m_hdr,0,sizeof(gpk_hdr));
+    m_hdr.head[0]='g';
+    m_hdr.head[1]='p';
+    m_hdr.head[2]='k';
+    m_hdr.head[3]='1';
+    m_hdr.version = GPK_VERSION;
+    m_hdr.width = width;
+    m_hdr.height = height;
+    m_hdr.hasmask = hasmask;
+    //header is rewritten by finish
+    if(pwrite(m_fd,&m_hdr,sizeof(gpk_hdr),0)!=sizeof(gpk_hdr))return -3;
+    m_offset = sizeof(gpk_hdr);
+    m_capacity = 0;
+    m_ready = 0;
+    vec_box.clear();
+    vec_inx.clear();
+    return 0;
+}
+
+int RolePackWriter::beginlive(const char* packfn,uint64_t capacity){
+    int rst = begin(packfn,0,0,0);
+    if(rst)return rst;
+    if(ftruncate(m_fd,capacity))return -4;
+    m_capacity = capacity;
+    vec_box.reserve(GPK_LIVEFRAMES*4);
+    vec_inx.reserve(GPK_LIVEFRAMES);
+    return 0;
+}
+
+//frame numbers may come from the network, every pack is capped
+int RolePackWriter::grow(int frame){
+    if(frame<0)return -1;
+    if(frame>=GPK_LIVEFRAMES)return -2;
+    size_t frames = (size_t)frame+1;
+    if(frames>vec_inx.size()){
+        gpk_inx item;
+        memset(&item,0,sizeof(gpk_inx));
+        vec_box.resize(frames*4,0);
+        vec_inx.resize(frames,item);
+    }
+    return 0;
+}
+
+int RolePackWriter::append(const uint8_t* buf,uint32_t size,uint64_t* poff){
+    if(m_capacity&&m_offset+size>m_capacity)return -5;
+    size_t done = 0;
+    while(done<size){
+        ssize_t n = pwrite(m_fd,buf+done,size-done,m_offset+done);
+        if(n<=0)return -6;
+        done += n;
+    }
+    *poff = m_offset;
+    m_offset += size;
+    return 0;
+}
+
+int RolePackWriter::add(const int* box,const uint8_t** bufs,const uint32_t* sizes){
+    if(m_fd<0)return -1;
+    if(!bufs[GPK_RAW]||!sizes[GPK_RAW])return -3;
+    int inx = vec_inx.size();
+    for(int k=0;k<GPK_PLANES;k++){
+        if(!bufs[k]||!sizes[k])continue;
+        int rst = put(inx,k,bufs[k],sizes[k]);
+        if(rst<0)return rst;
+    }
+    setbox(inx,box);
+    return vec_inx.size();
+}
+
+int RolePackWriter::put(int inx,int kind,const uint8_t* buf,uint32_t size){
+    if(m_fd<0)return -1;
+    if(kind<0||kind>=GPK_PLANES||!buf||!size)return -3;
+    int rst = grow(inx);
+    if(rst)return rst-10;
+    uint64_t off = 0;
+    rst = append(buf,size,&off);
+    if(rst)return rst;
+    vec_inx[inx].off[kind] = off;
+    vec_inx[inx].size[kind] = size;
+    return 0;
+}
+
+int RolePackWriter::setbox(int inx,const int* box){
+    int rst = grow(inx);
+    if(rst)return rst;
+    for(int k=0;k<4;k++)vec_box[(size_t)inx*4+k] = box?box[k]:0;
+    return 0;
+}
+
+int RolePackWriter::setinfo(int width,int height,int hasmask){
+    m_hdr.width = width;
+    m_hdr.height = height;
+    m_hdr.hasmask = hasmask;
+    return 0;
+}
+
+int RolePackWriter::has(int inx,int kind){
+    if(inx<0||inx>=(int)vec_inx.size())return 0;
+    if(kind<0||kind>=GPK_PLANES)return 0;
+    return vec_inx[inx].size[kind]>0;
+}
+
+int RolePackWriter::publish(int frames){
+    if(frames>(int)vec_inx.size())frames = vec_inx.size();
+    if(frames>m_ready.load())m_ready.store(frames,std::memory_order_release);
+    return frames;
+}
+
+static int readjpgfile(const char* fn,std::vector<uint8_t>& buf){
+    buf.clear();
+    if(!fn||!strlen(fn))return 0;
+    FILE* file = fopen(fn,"rb");
+    if(!file)return -1;
+    fseek(file,0,SEEK_END);
+    long size = ftell(file);
+    fseek(file,0,SEEK_SET);
+    if(size<=0){
+        fclose(file);
+        return -2;
+    }
+    buf.resize(size);
+    size_t rd = fread(buf.data(),size,1,file);
+    fclose(file);
+    return rd==1?0:-3;
+}
+
+int RolePackWriter::addfile(const int* box,const char* rawfn,const char* mskfn,const char* fgfn){
+    std::vector<uint8_t> data[GPK_PLANES];
+    const char* fns[GPK_PLANES] = {rawfn,mskfn,fgfn};
+    const uint8_t* bufs[GPK_PLANES];
+    uint32_t sizes[GPK_PLANES];
+    for(int k=0;k<GPK_PLANES;k++){
+        int rst = readjpgfile(fns[k],data[k]);
+        if(rst)return rst*10-k;
+        bufs[k] = data[k].size()?data[k].data():NULL;
+        sizes[k] = data[k].size();
+    }
+    return add(box,bufs,sizes);
+}
+
+int RolePackWriter::finish(){
+    if(m_fd<0)return -1;
+    int rst = 0;
+    m_hdr.frames = vec_inx.size();
+    m_hdr.boxoff = m_offset;
+    m_hdr.inxoff = m_hdr.boxoff + vec_box.size()*sizeof(int);
+    uint64_t off = 0;
+    if(vec_box.size()){
+        if(append((const uint8_t*)vec_box.data(),vec_box.size()*sizeof(int),&off))rst = -2;
+    }
+    if(vec_inx.size()){
+        if(append((const uint8_t*)vec_inx.data(),vec_inx.size()*sizeof(gpk_inx),&off))rst = -3;
+    }
+    if(pwrite(m_fd,&m_hdr,sizeof(gpk_hdr),0)!=sizeof(gpk_hdr))rst = -4;
+    //live packs were extended to capacity, cut back to what was written
+    if(m_capacity&&ftruncate(m_fd,m_offset))rst = -6;
+    if(::close(m_fd))rst = -5;
+    m_fd = -1;
+    publish(vec_inx.size());
+    return rst?rst:m_hdr.frames;
+}
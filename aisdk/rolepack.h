@@ -0,0 +1,117 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*
+ * role pack (.gpk) layout
+ *
+ *   gpk_hdr                     fixed header
+ *   jpeg payloads ...           raw / pha / raw_sg bytes, appended per frame
+ *   int[4] * frames             bbox table (x0,y0,x1,y1)
+ *   gpk_inx * frames            per frame payload offsets/sizes
+ *
+ * tables are written last so a pack can be built in one sequential pass.
+ * planes of one frame need not be adjacent, a streaming install appends each
+ * plane as it arrives and a live reader sees the tables in memory until finish.
+ * */
+extern "C"{
+#pragma pack(push)
+#pragma pack(4)
+
+    typedef struct _gpk_hdr {
+        char        head[4];
+        int         version;
+        int         frames;
+        int         width;
+        int         height;
+        int         hasmask;
+        uint64_t    boxoff;
+        uint64_t    inxoff;
+        int         reserved[8];
+    }gpk_hdr;
+
+    typedef struct _gpk_inx {
+        uint64_t    off[3];
+        uint32_t    size[3];
+    }gpk_inx;
+#pragma pack(pop)
+}
+
+#define GPK_VERSION 1
+
+#define GPK_RAW     0
+#define GPK_MASK    1
+#define GPK_FG      2
+#define GPK_PLANES  3
+//plane set as bitmask, for callers that only consume some planes
+#define GPK_BIT(k)  (1<<(k))
+#define GPK_ALL     (GPK_BIT(GPK_PLANES)-1)
+//frames a pack can hold; a live writer allocates its tables for all of them
+//once so readers keep valid pointers while the writer appends
+#define GPK_LIVEFRAMES  65536
+
+class RolePackWriter;
+
+class RolePack{
+    private:
+        int         m_fd = -1;
+        uint8_t*    m_map = nullptr;
+        uint64_t    m_mapsize = 0;
+        gpk_hdr*    m_hdr = nullptr;
+        int*        m_boxs = nullptr;
+        gpk_inx*    m_inxs = nullptr;
+        std::atomic<int>*   m_live = nullptr;
+    public:
+        int open(const char* packfn);
+        //read a pack a RolePackWriter started with beginlive while it is still
+        //being written; frames() grows with publish, the writer must outlive it
+        int openlive(RolePackWriter* writer);
+        void close();
+        int frames();
+        int width();
+        int height();
+        int hasmask();
+        const int* box(int inx);
+        int plane(int inx,int kind,const uint8_t** pbuf,uint32_t* psize);
+        int extent(int inx,int kind,uint64_t* poff,uint32_t* psize);
+        int fd(){return m_fd;};
+        RolePack();
+        virtual ~RolePack();
+};
+
+class RolePackWriter{
+    friend class RolePack;
+    private:
+        int         m_fd = -1;
+        gpk_hdr     m_hdr;
+        uint64_t    m_offset = 0;
+        uint64_t    m_capacity = 0;
+        std::string m_packfn;
+        std::vector<int>        vec_box;
+        std::vector<gpk_inx>    vec_inx;
+        std::atomic<int>        m_ready{0};
+        int         grow(int frame);
+        int         append(const uint8_t* buf,uint32_t size,uint64_t* poff);
+    public:
+        int begin(const char* packfn,int width,int height,int hasmask);
+        //as begin, the file is extended (sparse) to capacity so a live reader
+        //maps it once; at most GPK_LIVEFRAMES frames
+        int beginlive(const char* packfn,uint64_t capacity);
+        int add(const int* box,const uint8_t** bufs,const uint32_t* sizes);
+        int addfile(const int* box,const char* rawfn,const char* mskfn,const char* fgfn);
+        //one plane of frame inx, planes and frames may come in any order
+        int put(int inx,int kind,const uint8_t* buf,uint32_t size);
+        int setbox(int inx,const int* box);
+        int setinfo(int width,int height,int hasmask);
+        int has(int inx,int kind);
+        int count(){return vec_inx.size();};
+        //frames [0,frames) are complete and visible to live readers
+        int publish(int frames);
+        int published(){return m_ready.load();};
+        int finish();
+        RolePackWriter();
+        virtual ~RolePackWriter();
+};
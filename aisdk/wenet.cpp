@@ -17,6 +17,12 @@ void Wenet::initModel(const char* modelfn){
     //m_model->pushName("encoder_out",0);
 }
 
+void Wenet::initModel(const char* data,size_t size,const AiOpts& opts){
+    m_model = new OnnxModel();
+    m_model->setOpts(opts);
+    m_model->initModel(data,size);
+}
+
 int Wenet::calcbnf(float* melbin,int melnum,float* bnfbin,int bnfnum){
     int rst = 0;
     int chkmfcc = melnum;
@@ -55,6 +61,10 @@ Wenet::Wenet(const char* modelfn){
     initModel(modelfn);
 }
 
+Wenet::Wenet(const char* data,size_t size,const AiOpts& opts){
+    initModel(data,size,opts);
+}
+
 Wenet::~Wenet(){
     delete m_model;
 }
@@ -9,6 +9,7 @@ class Wenet{
     private:
         OnnxModel   *m_model = nullptr;
         void initModel(const char* modelfn);
+        void initModel(const char* data,size_t size,const AiOpts& opts);
     public:
         int calcmfcc(JMat* mwav,JMat* mmel);
         int calcmfcc(float* fwav,float* mel2);
@@ -18,5 +19,6 @@ class Wenet{
         float* nextbnf(JMat* bnfmat,int index);
         Wenet(const char* modeldir,const char* modelid);
         Wenet(const char* modelfn);
+        Wenet(const char* data,size_t size,const AiOpts& opts = AiOpts());
         ~Wenet();
 };
@@ -40,6 +40,7 @@ unsigned long FrameSource::pushVidFrame(MediaData *frame) {
 
 unsigned long FrameSource::pushVidRecyle(JMat *frame) {
     if(!frame)return 0;
+    std::lock_guard<std::mutex> lock(recyleLock);
     return videoRecyleQueue->push(frame);
 }
 
@@ -60,6 +61,7 @@ unsigned long FrameSource::readVidFrame(MediaData **frame) {
 }
 
 unsigned long FrameSource::popVidRecyle(JMat **frame) {
+    std::lock_guard<std::mutex> lock(recyleLock);
     unsigned long size = videoRecyleQueue->front(frame);
     if (size > 0) {
         videoRecyleQueue->pop();
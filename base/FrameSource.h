@@ -4,6 +4,7 @@
 
 #include "MediaData.h"
 #include "ConcurrentQueue.h"
+#include <mutex>
 
 
 class FrameSource {
@@ -42,6 +43,8 @@ private:
     ConcurrentQueue<MediaData *> *audioPacketQueue;
     ConcurrentQueue<MediaData *> *videoPacketQueue;
     ConcurrentQueue<JMat *> *videoRecyleQueue;
+    //render-ahead workers pop recycled mats concurrently, front+pop must not interleave
+    std::mutex recyleLock;
 };
 
 
@@ -6,6 +6,8 @@
 #include <unistd.h>
 #include "grtcfg.h"
 #include "benchmark.h"
+#include "cpu.h"
+#include "munetservice.h"
 
 #ifdef __ANDROID__
 #include "coffeecatch.h"
@@ -69,6 +71,9 @@ try{
         m_wenet = nullptr;
         Wenet* wenet = (Wenet*)obj;
         delete wenet;
+    }else if(what==-3){
+        //shared wenet, owned by role registry
+        m_wenet = nullptr;
     }else if(what==-11){
         KWav* matwav = (KWav*)obj;
         delete matwav;
@@ -125,7 +130,9 @@ LoopCurl::~LoopCurl(){
 }
 
 void GDigit::asyncWenet(int act,Wenet* wenet){
-    if(act){
+    if(act==2){
+        wenetThread->post(-3,wenet);
+    }else if(act){
         wenetThread->post(-2,wenet);
     }else{
         wenetThread->post(-1,wenet);
@@ -151,7 +158,7 @@ GDigit::GDigit(int width,int height, MessageCb *obj):GRender(width,height,obj) {
     curlThread = new LoopCurl();
     wenetThread = new LoopWenet();
     bnf_cache = new MBnfCache();
-    lock_munet = new std::mutex();
+    lock_munet = new std::shared_mutex();
 }
 
 GDigit::~GDigit() {
@@ -186,6 +193,12 @@ GDigit::~GDigit() {
     }
 }
 
+//a misspelled name falls back to ncnn's default, say so
+static int parseprec(const char* key,const char* name){
+    if(!ncnnprec_known(name))LOGE(TAG,"unknown %s:%s, use ncnn default",key,name);
+    return ncnnprec_parse(name);
+}
+
 int GDigit::config(const char* cfgtxt){
     rtcfg_t* cfg = make_rtcfgjson((char*)cfgtxt);
     if(!cfg)return -1;
@@ -203,6 +216,12 @@ int GDigit::config(const char* cfgtxt){
     if(cfg->wenetfn){
         initWenet(cfg->wenetfn);
     }
+    m_unetprec.storage = parseprec("unetstorage",cfg->unetstorage);
+    m_unetprec.arith = parseprec("unetarith",cfg->unetarith);
+    m_unetprec.flat = cfg->unetflat;
+    m_alphaprec.storage = parseprec("alphastorage",cfg->alphastorage);
+    m_alphaprec.arith = parseprec("alphaarith",cfg->alphaarith);
+    m_alphaprec.flat = cfg->alphaflat;
     LOGE(TAG,"ccc %s",cfg->unetmsk);
     if(cfg->unetbin&&cfg->unetparam&&cfg->unetmsk){
         initMunet(cfg->unetparam,cfg->unetbin,cfg->unetmsk);
@@ -230,29 +249,74 @@ int GDigit::initPfpld(char* fnparam,char* fnbin){
 }
 
 int GDigit::initWenet(char* fnwenet){
+    return shareWenet(new Wenet(fnwenet),1);
+}
+
+int GDigit::shareWenet(Wenet* wenet,int own){
     if(ai_wenet){
-        asyncWenet(1,ai_wenet);
+        asyncWenet(m_ownwenet?1:2,ai_wenet);
         ai_wenet = nullptr;
     }
-    ai_wenet = new Wenet(fnwenet);
-    asyncWenet(0,ai_wenet);
+    ai_wenet = wenet;
+    m_ownwenet = own;
+    if(ai_wenet)asyncWenet(0,ai_wenet);
     return 0;
 }
 
 int GDigit::initMunet(char* fnparam,char* fnbin,char* fnmsk){
-    Mobunet* munet = ai_munet;
+    shareMunet(new Mobunet(fnbin,fnparam,fnmsk,m_unetprec),1);
+    LOGE(TAG,"init munet");
+    return 0;
+}
+
+int GDigit::shareMunet(Mobunet* munet,int own){
+    Mobunet* oldnet = ai_munet;
+    int oldown = m_ownmunet;
     lock_munet->lock();
-    ai_munet = new Mobunet(fnbin,fnparam,fnmsk);
+    ai_munet = munet;
+    m_ownmunet = own;
     lock_munet->unlock();
-dispThread->dispatch([munet,this]() {
-    if(munet){
-        delete munet;
+dispThread->dispatch([oldnet,oldown,this]() {
+    if(oldnet&&oldown){
+        delete oldnet;
     }
 });
-    LOGE(TAG,"init munet");
     return 0;
 }
 
+int GDigit::setWorkers(int workers){
+    m_munetthreads = 0;
+    if(workers>1){
+        m_munetthreads = ncnn::get_big_cpu_count()/workers;
+        if(m_munetthreads<1)m_munetthreads = 1;
+    }
+    return m_munetthreads;
+}
+
+int GDigit::runmunet(JMat** pics,JMat** msks,JMat** feats,int count){
+    int rst = -13;
+    std::shared_lock<std::shared_mutex> lock(*lock_munet);
+    if(!ai_munet)return rst;
+    MunetService* service = MunetService::get();
+    if(service->running()){
+        //all submitted first so the service can batch them with other sessions
+        std::vector<std::future<int>> futs;
+        for(int k=0;k<count;k++){
+            futs.push_back(service->submit(ai_munet->shared(),pics[k],msks[k],feats[k]));
+        }
+        rst = 0;
+        for(auto& fut:futs){
+            int ret = fut.get();
+            if(ret)rst = ret;
+        }
+    }else if(count==1){
+        rst = ai_munet->domodel(pics[0],msks[0],feats[0],m_munetthreads);
+    }else{
+        rst = ai_munet->domodels(pics,msks,feats,count,m_munetthreads*count);
+    }
+    return rst;
+}
+
 int GDigit::initMalpha(char* fnparam,char* fnbin){
     if(1)return 0;
     MAlpha* malpha = ai_malpha;
@@ -261,7 +325,7 @@ dispThread->dispatch([malpha,this]() {
         delete malpha;
     }
 });
-    ai_malpha = new MAlpha(fnbin,fnparam);
+    ai_malpha = new MAlpha(fnbin,fnparam,m_alphaprec);
     LOGE(TAG,"init alpha");
     return 0;
 }
@@ -345,9 +409,9 @@ int GDigit::drawmskbuf(const char* picfn,const char* mskfn,char* dstbuf,char* ms
     if(!mat_msk)mat_msk = new JMat();
     int rst = 0;
     while(1){
-        rst = mat_pic->load(picfile);
+        rst = loadfile(mat_pic,picfile);
         if(rst)break;
-        rst = mat_msk->load(mskfile);
+        rst = loadfile(mat_msk,mskfile);
         break;
     }
     if(rst){
@@ -371,7 +435,7 @@ int GDigit::drawonebuf(const char* picfn,char* dstbuf,int size){
     if(!mat_pic)mat_pic = new JMat();
     int rst = 0;
     while(1){
-        rst = mat_pic->load(picfile);
+        rst = loadfile(mat_pic,picfile);
         if(rst)break;
         break;
     }
@@ -384,6 +448,94 @@ int GDigit::drawonebuf(const char* picfn,char* dstbuf,int size){
     return 0;//});
 }
 
+int GDigit::setPack(RolePack* pack){
+    m_pack = pack;
+    return 0;
+}
+
+int GDigit::setFaces(RoleFaces* faces){
+    m_faces = faces;
+    return 0;
+}
+
+const uint8_t* GDigit::packface(int frame,const int* box){
+    return m_faces?m_faces->face(frame,box):NULL;
+}
+
+int GDigit::setCache(MFrameCache* cache){
+    m_cache = cache;
+    return 0;
+}
+
+int GDigit::setReadAhead(MReadAhead* readahead,int waitms){
+    m_readahead = readahead;
+    m_readwait = waitms;
+    return 0;
+}
+
+int GDigit::loadplane(JMat* mat,int frame,int kind){
+    if(!m_pack)return -1;
+    if(m_cache&&!m_cache->get(frame,kind,mat))return 0;
+    int rst = m_readahead?m_readahead->take(frame,kind,mat,m_readwait):-1;
+    if(rst){
+        const uint8_t* buf = NULL;
+        uint32_t size = 0;
+        rst = m_pack->plane(frame,kind,&buf,&size);
+        if(rst)return rst;
+        rst = mat->loadjpg(buf,size);
+    }
+    if(!rst&&m_cache)m_cache->put(frame,kind,mat);
+    return rst;
+}
+
+int GDigit::loadfile(JMat* mat,const std::string& fn){
+    if(m_cache&&!m_cache->get(fn,mat))return 0;
+    int rst = m_readahead?m_readahead->take(fn,mat,m_readwait):-1;
+    if(rst)rst = mat->load(fn);
+    if(!rst&&m_cache)m_cache->put(fn,mat);
+    return rst;
+}
+
+int GDigit::setRoiDecode(int roi){
+    m_roidecode = roi;
+    return 0;
+}
+
+//raw plane of a frame whose output comes from fg: only the face box is read
+int GDigit::loadroiplane(JMat* mat,int frame,const int* box){
+    if(!m_roidecode)return loadplane(mat,frame,GPK_RAW);
+    if(!m_pack)return -1;
+    if(m_cache&&!m_cache->get(frame,GPK_RAW,mat))return 0;
+    const uint8_t* buf = NULL;
+    uint32_t size = 0;
+    int rst = m_pack->plane(frame,GPK_RAW,&buf,&size);
+    if(rst)return rst;
+    return mat->loadjpgroi(buf,size,box);
+}
+
+int GDigit::loadroifile(JMat* mat,const std::string& fn,const int* box){
+    if(!m_roidecode)return loadfile(mat,fn);
+    if(m_cache&&!m_cache->get(fn,mat))return 0;
+    int len = fn.length();
+    if((len>3)&&!fn.compare(len-3,3,"gpg"))return loadfile(mat,fn);
+    return mat->loadjpgroi(fn,box);
+}
+
+int GDigit::drawonepack(int frame,char* dstbuf,int size){
+    if(!m_pack)return -997;
+    JMat* mat_pic = NULL;
+    frameSource->popVidRecyle(&mat_pic);
+    if(!mat_pic)mat_pic = new JMat();
+    int rst = loadplane(mat_pic,frame,GPK_RAW);
+    if(rst){
+        delete mat_pic;
+        return rst*1000;
+    }
+    memcpy(dstbuf,mat_pic->data(),size);
+    frameSource->pushVidRecyle(mat_pic);
+    return 0;
+}
+
 
 int GDigit::drawmskpic(const char* picfn,const char* mskfn){
     if(!m_status)return -1000;
@@ -399,9 +551,9 @@ int GDigit::drawmskpic(const char* picfn,const char* mskfn){
     if(!mat_msk)mat_msk = new JMat();
     int rst = 0;
     while(1){
-        rst = mat_pic->load(picfile);
+        rst = loadfile(mat_pic,picfile);
         if(rst)break;
-        rst = mat_msk->load(mskfile);
+        rst = loadfile(mat_msk,mskfile);
         break;
     }
     if(rst){
@@ -419,7 +571,7 @@ int GDigit::drawmskpic(const char* picfn,const char* mskfn){
     return 0;
 }
 
-int GDigit::mskrstbuf(int index,const char* picfn,int* box,const char* mskfn,const char* fgfn,char* dstbuf,char* mskbuf,int size){
+int GDigit::mskrstbuf(int index,const char* picfn,int* box,const char* mskfn,const char* fgfn,char* dstbuf,char* mskbuf,int size,int planes){
     if(!m_status)return -1000;
     if(!ai_wenet)return -999;
     if(!ai_munet)return -998;
@@ -428,28 +580,31 @@ int GDigit::mskrstbuf(int index,const char* picfn,int* box,const char* mskfn,con
     if(index<0)return -2;
     if(index>=cnt_wenet)return -3;
     std::string picfile(picfn);
-    std::string mskfile(mskfn);
-    std::string fgfile(strlen(fgfn)?fgfn:"");
+    std::string mskfile(mskfn?mskfn:"");
+    std::string fgfile((fgfn&&strlen(fgfn))?fgfn:"");
 
     JMat* mat_fg = NULL;//new JMat(fgfile,1);
     JMat* mat_pic = NULL;//new JMat(picfile,1);
     JMat* mat_msk = NULL;//new JMat(mskfile,1);
-    int hasfg = fgfile.length();
+    int hasfg = fgfile.length()&&(planes&GPK_BIT(GPK_FG));
+    int hasmsk = mskbuf&&(planes&GPK_BIT(GPK_MASK));
     frameSource->popVidRecyle(&mat_pic);
-    frameSource->popVidRecyle(&mat_msk);
     if(!mat_pic)mat_pic = new JMat();
-    if(!mat_msk)mat_msk = new JMat();
+    if(hasmsk){
+        frameSource->popVidRecyle(&mat_msk);
+        if(!mat_msk)mat_msk = new JMat();
+    }
     if(hasfg){
         frameSource->popVidRecyle(&mat_fg);
         if(!mat_fg)mat_fg = new JMat();
     }
     int rst = 0;
     while(1){
-        rst = mat_pic->load(picfile);
+        rst = hasfg?loadroifile(mat_pic,picfile,box):loadfile(mat_pic,picfile);
         if(rst)break;
-        rst = mat_msk->load(mskfile);
+        if(hasmsk) rst = loadfile(mat_msk,mskfile);
         if(rst)break;
-        if(hasfg) rst = mat_fg->load(fgfile);
+        if(hasfg) rst = loadfile(mat_fg,fgfile);
         break;
     }
     if(rst){
@@ -458,7 +613,146 @@ int GDigit::mskrstbuf(int index,const char* picfn,int* box,const char* mskfn,con
         if(mat_fg) delete mat_fg;
         return rst*10000;
     }
-    if(size<mat_pic->size()){
+    return mskrstmat(index,mat_pic,mat_msk,mat_fg,box,dstbuf,mskbuf,size);
+}
+
+int GDigit::mskrstpack(int index,int frame,char* dstbuf,char* mskbuf,int size,int planes){
+    if(!m_status)return -1000;
+    if(!ai_wenet)return -999;
+    if(!ai_munet)return -998;
+    if(!m_pack)return -997;
+    if(!net_wavmat)return -1;
+    if(index<0)return -2;
+    if(index>=cnt_wenet)return -3;
+    int box[4];
+    JMat* mat_fg = NULL;
+    JMat* mat_pic = NULL;
+    JMat* mat_msk = NULL;
+    int rst = loadpackmats(frame,planes,mskbuf!=NULL,box,&mat_pic,&mat_msk,&mat_fg);
+    if(rst)return rst;
+    return mskrstmat(index,mat_pic,mat_msk,mat_fg,box,dstbuf,mskbuf,size,packface(frame,box));
+}
+
+//decoded planes of a pack frame for a lip-sync render, from the recycle pool;
+//*ppic stays NULL when the output is fg and the face was compiled
+int GDigit::loadpackmats(int frame,int planes,int wantmsk,int* box,JMat** ppic,JMat** pmsk,JMat** pfg){
+    const int* pbox = m_pack->box(frame);
+    if(!pbox)return -4;
+    for(int k=0;k<4;k++)box[k] = pbox[k];
+
+    JMat* mat_fg = NULL;
+    JMat* mat_pic = NULL;
+    JMat* mat_msk = NULL;
+    const uint8_t* fgbuf = NULL;
+    uint32_t fgsize = 0;
+    int hasfg = (planes&GPK_BIT(GPK_FG))&&(m_pack->plane(frame,GPK_FG,&fgbuf,&fgsize)==0);
+    int hasmsk = wantmsk&&(planes&GPK_BIT(GPK_MASK));
+    int hasraw = !(hasfg&&packface(frame,box));
+    if(hasraw){
+        frameSource->popVidRecyle(&mat_pic);
+        if(!mat_pic)mat_pic = new JMat();
+    }
+    if(hasmsk){
+        frameSource->popVidRecyle(&mat_msk);
+        if(!mat_msk)mat_msk = new JMat();
+    }
+    if(hasfg){
+        frameSource->popVidRecyle(&mat_fg);
+        if(!mat_fg)mat_fg = new JMat();
+    }
+    int rst = 0;
+    while(1){
+        if(hasraw) rst = hasfg?loadroiplane(mat_pic,frame,box):loadplane(mat_pic,frame,GPK_RAW);
+        if(rst)break;
+        if(hasmsk) rst = loadplane(mat_msk,frame,GPK_MASK);
+        if(rst)break;
+        if(hasfg) rst = loadplane(mat_fg,frame,GPK_FG);
+        break;
+    }
+    if(rst){
+        if(mat_pic) delete mat_pic;
+        if(mat_msk) delete mat_msk;
+        if(mat_fg) delete mat_fg;
+        return rst*10000;
+    }
+    *ppic = mat_pic;
+    *pmsk = mat_msk;
+    *pfg = mat_fg;
+    return 0;
+}
+
+int GDigit::rstpackbatch(int index,int count,const int* frames,char** dstbufs,int size,int masked,int planes){
+    if(!m_status)return -1000;
+    if(!ai_wenet)return -999;
+    if(!ai_munet)return -998;
+    if(!m_pack)return -997;
+    if(!net_wavmat)return -1;
+    if(index<0||count<=0)return -2;
+    if(index+count>cnt_wenet)return -3;
+    struct Item{
+        int         box[4];
+        JMat        *pic = NULL;
+        JMat        *msk = NULL;
+        JMat        *fg = NULL;
+        JMat        *feat = NULL;
+        MWorkMat    *wmat = NULL;
+        JMat        *mpic = NULL;
+        JMat        *mmsk = NULL;
+        const uint8_t   *face = NULL;
+    };
+    std::vector<Item> items(count);
+    int rst = 0;
+    for(int k=0;k<count&&!rst;k++){
+        Item& it = items[k];
+        if(masked){
+            rst = loadpackmats(frames[k],planes,0,it.box,&it.pic,&it.msk,&it.fg);
+        }else{
+            rst = loadpackmats(frames[k],GPK_BIT(GPK_RAW),0,it.box,&it.pic,&it.msk,&it.fg);
+        }
+        if(rst)break;
+        it.face = packface(frames[k],it.box);
+        if(size<(it.pic?it.pic:it.fg)->size()){
+            rst = -10000;
+            break;
+        }
+        it.feat = bnf_cache->inxBuf(index+k);
+        if(!it.feat){
+            rst = -14;
+            break;
+        }
+        it.wmat = new MWorkMat(it.pic,NULL,it.box);
+        //masked roles key the green spill even when the mask is not decoded
+        if(masked)it.wmat->keygreen(1);
+        it.wmat->premunet(it.face);
+        it.wmat->munet(&it.mpic,&it.mmsk);
+    }
+    if(!rst){
+        std::vector<JMat*> pics(count),msks(count),feats(count);
+        for(int k=0;k<count;k++){
+            pics[k] = items[k].mpic;
+            msks[k] = items[k].mmsk;
+            feats[k] = items[k].feat;
+        }
+        rst = runmunet(pics.data(),msks.data(),feats.data(),count);
+    }
+    for(int k=0;k<count;k++){
+        Item& it = items[k];
+        if(!rst){
+            JMat* out = masked?it.fg:NULL;
+            it.wmat->finmunet(out?out:it.pic);
+            memcpy(dstbufs[k],out?out->data():it.pic->data(),size);
+        }
+        if(it.wmat)delete it.wmat;
+        if(it.feat)delete it.feat;
+        if(it.pic) frameSource->pushVidRecyle(it.pic);
+        if(it.msk) frameSource->pushVidRecyle(it.msk);
+        if(it.fg) frameSource->pushVidRecyle(it.fg);
+    }
+    return rst;
+}
+
+int GDigit::mskrstmat(int index,JMat* mat_pic,JMat* mat_msk,JMat* mat_fg,int* box,char* dstbuf,char* mskbuf,int size,const uint8_t* face){
+    if(size<(mat_pic?mat_pic:mat_fg)->size()){
         if(mat_pic) delete mat_pic;
         if(mat_msk) delete mat_msk;
         if(mat_fg) delete mat_fg;
@@ -469,20 +763,27 @@ int GDigit::mskrstbuf(int index,const char* picfn,int* box,const char* mskfn,con
     JMat* mat_feat = bnf_cache->inxBuf(index);
     if(!mat_feat)return -14;
     MWorkMat wmat(mat_pic,mat_msk,arr);
-    wmat.premunet();
+    //masked roles key the green spill even when the mask is not decoded
+    wmat.keygreen(1);
+    wmat.premunet(face);
     JMat *mpic, *mmsk;
     wmat.munet(&mpic,&mmsk);
-    lock_munet->lock();
-    if(ai_munet) ai_munet->domodel(mpic, mmsk, mat_feat);
-    lock_munet->unlock();
+    int rst = runmunet(&mpic,&mmsk,&mat_feat,1);
+    delete mat_feat;
+    if(rst){
+        if(mat_pic) frameSource->pushVidRecyle(mat_pic);
+        if(mat_msk) frameSource->pushVidRecyle(mat_msk);
+        if(mat_fg) frameSource->pushVidRecyle(mat_fg);
+        return rst;
+    }
     wmat.finmunet(mat_fg);
     //memcpy(mat_fg->data(),dstbuf,size);
-    memcpy(dstbuf,mat_fg->data(),size);
-    memcpy(mskbuf,mat_msk->data(),size);
+    memcpy(dstbuf,mat_fg?mat_fg->data():mat_pic->data(),size);
+    if(mat_msk) memcpy(mskbuf,mat_msk->data(),size);
     //todo
-    frameSource->pushVidRecyle(mat_pic);
-    frameSource->pushVidRecyle(mat_msk);
-    frameSource->pushVidRecyle(mat_fg);
+    if(mat_pic) frameSource->pushVidRecyle(mat_pic);
+    if(mat_msk) frameSource->pushVidRecyle(mat_msk);
+    if(mat_fg) frameSource->pushVidRecyle(mat_fg);
     return 0;
 }
 
@@ -501,7 +802,7 @@ int GDigit::onerstbuf(int index,const char* picfn,int* box,char* dstbuf,int size
     if(!mat_pic)mat_pic = new JMat();
     int rst = 0;
     while(1){
-        rst = mat_pic->load(picfile);
+        rst = loadfile(mat_pic,picfile);
         if(rst)break;
         break;
     }
@@ -509,6 +810,33 @@ int GDigit::onerstbuf(int index,const char* picfn,int* box,char* dstbuf,int size
         if(mat_pic) delete mat_pic;
         return rst*10000;
     }
+    return onerstmat(index,mat_pic,box,dstbuf,size);
+}
+
+int GDigit::onerstpack(int index,int frame,char* dstbuf,int size){
+    if(!m_status)return -1000;
+    if(!ai_wenet)return -999;
+    if(!ai_munet)return -998;
+    if(!m_pack)return -997;
+    if(!net_wavmat)return -1;
+    if(index<0)return -2;
+    if(index>=cnt_wenet)return -3;
+    const int* pbox = m_pack->box(frame);
+    if(!pbox)return -4;
+    int box[4]={pbox[0],pbox[1],pbox[2],pbox[3]};
+
+    JMat* mat_pic = NULL;
+    frameSource->popVidRecyle(&mat_pic);
+    if(!mat_pic)mat_pic = new JMat();
+    int rst = loadplane(mat_pic,frame,GPK_RAW);
+    if(rst){
+        if(mat_pic) delete mat_pic;
+        return rst*10000;
+    }
+    return onerstmat(index,mat_pic,box,dstbuf,size,packface(frame,box));
+}
+
+int GDigit::onerstmat(int index,JMat* mat_pic,int* box,char* dstbuf,int size,const uint8_t* face){
     if(size<mat_pic->size()){
         if(mat_pic) delete mat_pic;
         return -10000;
@@ -518,12 +846,15 @@ int GDigit::onerstbuf(int index,const char* picfn,int* box,char* dstbuf,int size
     JMat* mat_feat = bnf_cache->inxBuf(index);
     if(!mat_feat)return -14;
     MWorkMat wmat(mat_pic,NULL,arr);
-    wmat.premunet();
+    wmat.premunet(face);
     JMat *mpic, *mmsk;
     wmat.munet(&mpic,&mmsk);
-    lock_munet->lock();
-    if(ai_munet) ai_munet->domodel(mpic, mmsk, mat_feat);
-    lock_munet->unlock();
+    int rst = runmunet(&mpic,&mmsk,&mat_feat,1);
+    delete mat_feat;
+    if(rst){
+        frameSource->pushVidRecyle(mat_pic);
+        return rst;
+    }
     //todo
     wmat.finmunet(mat_pic);
     //memcpy(mat_fg->data(),dstbuf,size);
@@ -561,13 +892,13 @@ int GDigit::mskrstpic(int index,const char* picfn,int* box,const char* mskfn,con
     }
     int rst = 0;
     while(1){
-        rst = mat_pic->load(picfile);
+        rst = loadfile(mat_pic,picfile);
         //printf("===matpic %d\n",rst);
         if(rst)break;
-        rst = mat_msk->load(mskfile);
+        rst = loadfile(mat_msk,mskfile);
         //printf("===mat msk %d\n",rst);
         if(rst)break;
-        if(hasfg) rst = mat_fg->load(fgfile);
+        if(hasfg) rst = loadfile(mat_fg,fgfile);
         //printf("===mat fg %d\n",rst);
         break;
     }
@@ -799,7 +1130,7 @@ void GDigit::recyle(){
 dispThread->dispatch([this]() {
     if(ai_munet){
         lock_munet->lock();
-        delete ai_munet;
+        if(m_ownmunet)delete ai_munet;
         ai_munet = nullptr;
         lock_munet->unlock();
     }
@@ -813,7 +1144,7 @@ dispThread->dispatch([this]() {
     }
 });
     if(ai_wenet){
-        asyncWenet(1,ai_wenet);
+        asyncWenet(m_ownwenet?1:2,ai_wenet);
         ai_wenet = nullptr;
     }
     if(net_wavmat){
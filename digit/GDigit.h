@@ -13,6 +13,12 @@
 #include "dispatchqueue.hpp"
 #include "malpha.h"
 #include "wavcache.h"
+#include "rolepack.h"
+#include "roleface.h"
+#include "framecache.h"
+#include "readahead.h"
+#include "renderahead.h"
+#include <shared_mutex>
 
 class LoopWenet:public looper{
     private:
@@ -52,10 +58,34 @@ class GDigit :public GRender{
         int drawmskpic(const char* picfn,const char* mskfn);
         int drawmskbuf(const char* picfn,const char* mskfn,char* dstbuf,char* mskbuf,int size);
         int mskrstpic(int index,const char* picfn,int* box,const char* mskfn,const char* fgfn);
-        int mskrstbuf(int index,const char* picfn,int* box,const char* mskfn,const char* fgfn,char* dstbuf,char* mskbuf,int size);
+        //planes: GPK_BIT set of the planes the caller consumes, mskbuf is only
+        //written with GPK_MASK and may be NULL without it, without GPK_FG the
+        //frame is composed on raw instead of raw_sg
+        int mskrstbuf(int index,const char* picfn,int* box,const char* mskfn,const char* fgfn,char* dstbuf,char* mskbuf,int size,int planes = GPK_ALL);
         int drawonebuf(const char* picfn,char* dstbuf,int size);
         int onerstbuf(int index,const char* picfn,int* box,char* dstbuf,int size);
 
+        int setPack(RolePack* pack);
+        //faces compiled from the pack: premunet copies them instead of cutting
+        //the frame, and frames composed on fg skip decoding raw altogether
+        int setFaces(RoleFaces* faces);
+        int drawonepack(int frame,char* dstbuf,int size);
+        int onerstpack(int index,int frame,char* dstbuf,int size);
+        int mskrstpack(int index,int frame,char* dstbuf,char* mskbuf,int size,int planes = GPK_ALL);
+        //audio indices [index,index+count) on pack frames[k] into dstbufs[k];
+        //the count inferences run together, as mskrstpack when masked else onerstpack
+        int rstpackbatch(int index,int count,const int* frames,char** dstbufs,int size,int masked,int planes = GPK_ALL);
+
+        int setCache(MFrameCache* cache);
+        int setReadAhead(MReadAhead* readahead,int waitms = 20);
+        int setRoiDecode(int roi);
+        //shared models are owned by the caller when own==0
+        int shareWenet(Wenet* wenet,int own=0);
+        int shareMunet(Mobunet* munet,int own=0);
+        //workers>1: mskrst/onerst run from that many threads at once, each
+        //inference then gets its share of the cores instead of all of them
+        int setWorkers(int workers);
+
         int netrstpic(const char* picfn,int* box,int index,const char* dumpfn);
         int drawpic(const char* picfn);
 
@@ -74,8 +104,17 @@ class GDigit :public GRender{
 
         Wenet* ai_wenet = nullptr;
         Mobunet* ai_munet = nullptr;
+        int     m_ownwenet = 1;
+        int     m_ownmunet = 1;
         MAlpha* ai_malpha = nullptr;
-        std::mutex  *lock_munet;
+        //precision of the models config() loads itself
+        NcnnPrec    m_unetprec;
+        NcnnPrec    m_alphaprec;
+        //shared while inferring, exclusive to swap the net
+        std::shared_mutex  *lock_munet;
+        int     m_munetthreads = 0;
+        //count inferences under lock_munet, through MunetService when it runs
+        int     runmunet(JMat** pics,JMat** msks,JMat** feats,int count);
 
         NetCurl* net_curl = nullptr;
         KWav*   net_wavmat = nullptr;
@@ -96,6 +135,22 @@ class GDigit :public GRender{
         volatile int    m_working = 0;
 
         void            clear();
+
+        RolePack        *m_pack = nullptr;
+        RoleFaces       *m_faces = nullptr;
+        const uint8_t*  packface(int frame,const int* box);
+        MFrameCache     *m_cache = nullptr;
+        MReadAhead      *m_readahead = nullptr;
+        int             m_readwait = 20;
+        int             loadplane(JMat* mat,int frame,int kind);
+        int             loadpackmats(int frame,int planes,int wantmsk,int* box,JMat** ppic,JMat** pmsk,JMat** pfg);
+        int             loadfile(JMat* mat,const std::string& fn);
+        int             m_roidecode = 0;
+        int             loadroiplane(JMat* mat,int frame,const int* box);
+        int             loadroifile(JMat* mat,const std::string& fn,const int* box);
+        //mat_pic may be NULL with mat_fg and a compiled face
+        int             mskrstmat(int index,JMat* mat_pic,JMat* mat_msk,JMat* mat_fg,int* box,char* dstbuf,char* mskbuf,int size,const uint8_t* face = NULL);
+        int             onerstmat(int index,JMat* mat_pic,int* box,char* dstbuf,int size,const uint8_t* face = NULL);
     public:
 
         virtual void prepare();
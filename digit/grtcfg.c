@@ -105,6 +105,7 @@ static int cjson_listnval(cJSON* root,char** name,int** val){
 
 static   char* g_ncfgname[] = {
         "action","videowidth", "videoheight", "timeoutms",
+        "unetflat","alphaflat",
         NULL};
 
 static   char* g_scfgname[] = {
@@ -112,6 +113,7 @@ static   char* g_scfgname[] = {
         "unetmsk","alphabin","alphaparam",
         "cacertfn","scrfdbin","scrfdparam",
         "pfpldbin","pfpldparam",
+        "unetstorage","unetarith","alphastorage","alphaarith",
         NULL};
 
 static void destroy_rtcfg(void* arg){
@@ -140,6 +142,7 @@ rtcfg_t* make_rtcfgjson(char* str){
     int* arrval[] = {
         &cfg->action, &cfg->videowidth, &cfg->videoheight,
         &cfg->timeoutms,
+        &cfg->unetflat, &cfg->alphaflat,
         NULL};
     cjson_listnval(root,g_ncfgname,arrval);
     char** arrstr[] = {
@@ -155,6 +158,10 @@ rtcfg_t* make_rtcfgjson(char* str){
         &cfg->scrfdparam,
         &cfg->pfpldbin,
         &cfg->pfpldparam,
+        &cfg->unetstorage,
+        &cfg->unetarith,
+        &cfg->alphastorage,
+        &cfg->alphaarith,
         NULL,
     };
     cjson_listsval(root,g_scfgname,arrstr);
@@ -26,6 +26,14 @@ extern "C" {
         char*   scrfdparam;
         char*   pfpldbin;
         char*   pfpldparam;
+        //ncnn precision "fp32"/"fp16"/"bf16" of weights (storage) and math (arith)
+        char*   unetstorage;
+        char*   unetarith;
+        char*   alphastorage;
+        char*   alphaarith;
+        //1 keeps the model off the simd packed layout
+        int     unetflat;
+        int     alphaflat;
         void                *base_obj;
     };
 
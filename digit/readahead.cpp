@@ -0,0 +1,284 @@
+#include "readahead.h"
+#include <Log.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TAG "tooken"
+
+MReadAhead::Item::~Item(){
+    if(ownfd&&(fd>=0))::close(fd);
+    if(buf)delete buf;
+    if(mat)delete mat;
+}
+
+static int openitem(const std::string& fn,int* pfd,uint32_t* psize){
+    int fd = ::open(fn.c_str(),O_RDONLY);
+    if(fd<0)return -1;
+    struct stat st;
+    if(fstat(fd,&st)<0||st.st_size<=0){
+        ::close(fd);
+        return -2;
+    }
+    *pfd = fd;
+    *psize = st.st_size;
+    return 0;
+}
+
+int MReadAhead::setCache(MFrameCache* cache){
+    m_cache = cache;
+    return 0;
+}
+
+int MReadAhead::prefetch(RolePack* pack,int frame,int planes){
+    if(!pack)return -997;
+    int cnt = 0;
+    for(int k=0;k<GPK_PLANES;k++){
+        if(!(planes&GPK_BIT(k)))continue;
+        uint64_t off = 0;
+        uint32_t size = 0;
+        if(pack->extent(frame,k,&off,&size))continue;
+        std::string key = MFrameCache::planekey(frame,k);
+        if(m_cache&&m_cache->has(key))continue;
+        ItemPtr item = std::make_shared<Item>();
+        item->fd = pack->fd();
+        item->off = off;
+        item->size = size;
+        if(additem(key,item)>0)cnt++;
+    }
+    return cnt;
+}
+
+int MReadAhead::prefetch(const std::string& fn){
+    int len = fn.length();
+    if(len<4)return 0;
+    //gpg mats are not jpeg, JMat::load reads them itself
+    if(!fn.compare(len-3,3,"gpg"))return 0;
+    if(m_cache&&m_cache->has(fn))return 0;
+    ItemPtr item = std::make_shared<Item>();
+    item->fn = fn;
+    return additem(fn,item)>0?1:0;
+}
+
+int MReadAhead::additem(const std::string& key,ItemPtr item){
+    std::unique_lock<std::mutex> lock(*m_lock);
+    if(map_item.count(key))return 0;
+    if((int)map_item.size()>=m_maxitem)evict();
+    if((int)map_item.size()>=m_maxitem)return -1;
+    map_item[key] = item;
+    que_key.push_back(key);
+    if((int)que_key.size()>4*m_maxitem){
+        std::deque<std::string> keys;
+        for(auto& k:que_key){
+            if(map_item.count(k))keys.push_back(k);
+        }
+        que_key.swap(keys);
+    }
+#ifdef HAVE_LIBURING
+    if(m_uring){
+        vec_submit.push_back(item);
+        lock.unlock();
+        m_subcond.notify_one();
+        return 1;
+    }
+#endif
+    lock.unlock();
+    m_pool->dispatch([this,item](){
+        finish(item,readitem(item));
+    });
+    return 1;
+}
+
+void MReadAhead::evict(){
+    //oldest finished items first, reads in flight stay
+    size_t n = que_key.size();
+    while(n--&&((int)map_item.size()>=m_maxitem)){
+        std::string key = que_key.front();
+        que_key.pop_front();
+        auto it = map_item.find(key);
+        if(it==map_item.end())continue;
+        if(!it->second->state){
+            que_key.push_back(key);
+            continue;
+        }
+        map_item.erase(it);
+    }
+}
+
+int MReadAhead::readitem(ItemPtr item){
+    if(item->fd<0){
+        int rst = openitem(item->fn,&item->fd,&item->size);
+        if(rst)return rst;
+        item->ownfd = 1;
+        item->off = 0;
+    }
+    item->buf = new JBuf(item->size);
+    uint8_t* buf = (uint8_t*)item->buf->data();
+    uint32_t done = 0;
+    while(done<item->size){
+        ssize_t rd = pread(item->fd,buf+done,item->size-done,item->off+done);
+        if(rd<=0)return -3;
+        done += rd;
+    }
+    if(item->ownfd){
+        ::close(item->fd);
+        item->fd = -1;
+        item->ownfd = 0;
+    }
+    if(m_decode){
+        item->mat = new JMat();
+        return item->mat->loadjpg(buf,item->size);
+    }
+    return 0;
+}
+
+void MReadAhead::finish(ItemPtr item,int rst){
+    std::unique_lock<std::mutex> lock(*m_lock);
+    item->state = rst?(rst<0?rst:-rst):1;
+    lock.unlock();
+    m_cond.notify_all();
+}
+
+int MReadAhead::takekey(const std::string& key,JMat* dst,int timeoutms){
+    std::unique_lock<std::mutex> lock(*m_lock);
+    auto it = map_item.find(key);
+    if(it==map_item.end())return -1;
+    ItemPtr item = it->second;
+    if(!item->state){
+        m_cond.wait_for(lock,std::chrono::milliseconds(timeoutms),[&]{
+                return item->state||m_quit;
+                });
+        if(!item->state)return -2;
+    }
+    map_item.erase(key);
+    lock.unlock();
+    if(item->state<0)return item->state;
+    if(item->mat)return dst->loadmat(item->mat);
+    return dst->loadjpg((uint8_t*)item->buf->data(),item->size);
+}
+
+int MReadAhead::take(int frame,int kind,JMat* dst,int timeoutms){
+    return takekey(MFrameCache::planekey(frame,kind),dst,timeoutms);
+}
+
+int MReadAhead::take(const std::string& fn,JMat* dst,int timeoutms){
+    return takekey(fn,dst,timeoutms);
+}
+
+void MReadAhead::clear(){
+    std::lock_guard<std::mutex> lock(*m_lock);
+    map_item.clear();
+    que_key.clear();
+}
+
+#ifdef HAVE_LIBURING
+void MReadAhead::ioloop(){
+    std::vector<ItemPtr> subs;
+    int inflight = 0;
+    while(!m_quit||inflight){
+        if(!m_quit){
+            std::unique_lock<std::mutex> lock(*m_lock);
+            if(!inflight){
+                m_subcond.wait_for(lock,std::chrono::milliseconds(100),[this]{
+                        return vec_submit.size()||m_quit;
+                        });
+            }
+            subs.swap(vec_submit);
+        }
+        for(auto& item:subs){
+            int rst = 0;
+            if(item->fd<0){
+                rst = openitem(item->fn,&item->fd,&item->size);
+                if(!rst){
+                    item->ownfd = 1;
+                    item->off = 0;
+                }
+            }
+            if(!rst){
+                item->buf = new JBuf(item->size);
+                struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+                if(!sqe){
+                    io_uring_submit(&m_ring);
+                    sqe = io_uring_get_sqe(&m_ring);
+                }
+                if(sqe){
+                    io_uring_prep_read(sqe,item->fd,item->buf->data(),item->size,item->off);
+                    io_uring_sqe_set_data(sqe,new ItemPtr(item));
+                    inflight++;
+                }else{
+                    rst = -4;
+                }
+            }
+            if(rst)finish(item,rst);
+        }
+        subs.clear();
+        if(!inflight)continue;
+        io_uring_submit(&m_ring);
+        struct __kernel_timespec ts = {0,2*1000*1000};
+        struct io_uring_cqe* cqe = NULL;
+        if(io_uring_wait_cqe_timeout(&m_ring,&cqe,&ts))continue;
+        unsigned head;
+        int cnt = 0;
+        io_uring_for_each_cqe(&m_ring,head,cqe){
+            ItemPtr* pitem = (ItemPtr*)io_uring_cqe_get_data(cqe);
+            ItemPtr item = *pitem;
+            delete pitem;
+            int res = cqe->res;
+            cnt++;
+            inflight--;
+            if(item->ownfd){
+                ::close(item->fd);
+                item->fd = -1;
+                item->ownfd = 0;
+            }
+            if(res!=(int)item->size){
+                finish(item,res<0?res:-5);
+            }else if(m_decode&&!m_quit){
+                m_pool->dispatch([this,item](){
+                    item->mat = new JMat();
+                    finish(item,item->mat->loadjpg((uint8_t*)item->buf->data(),item->size));
+                });
+            }else{
+                finish(item,0);
+            }
+        }
+        io_uring_cq_advance(&m_ring,cnt);
+    }
+}
+#endif
+
+MReadAhead::MReadAhead(int depth,int decode,int threads){
+    m_depth = depth>0?depth:1;
+    m_decode = decode;
+    m_maxitem = m_depth*GPK_PLANES*2;
+    m_lock = new std::mutex();
+    m_pool = new DispatchQueue("ReadAhead",threads>0?threads:1);
+#ifdef HAVE_LIBURING
+    unsigned entries = 8;
+    while((int)entries<m_maxitem)entries<<=1;
+    int rst = io_uring_queue_init(entries,&m_ring,0);
+    if(!rst){
+        m_uring = 1;
+        m_iothread = std::thread(&MReadAhead::ioloop,this);
+    }else{
+        LOGE(TAG,"io_uring init %d, use pread pool",rst);
+    }
+#endif
+}
+
+MReadAhead::~MReadAhead(){
+    m_quit = 1;
+    m_cond.notify_all();
+#ifdef HAVE_LIBURING
+    if(m_uring){
+        m_subcond.notify_all();
+        if(m_iothread.joinable())m_iothread.join();
+        io_uring_queue_exit(&m_ring);
+        m_uring = 0;
+    }
+#endif
+    delete m_pool;
+    m_pool = nullptr;
+    clear();
+    delete m_lock;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "jmat.h"
+#include "rolepack.h"
+#include "framecache.h"
+#include "dispatchqueue.hpp"
+#include <string>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/*
+ * read-ahead of upcoming role frames
+ *
+ * the render loop announces the frames it will draw next with prefetch(),
+ * their jpeg bytes (and, with decode set, the decoded pixels) are read off
+ * the render thread and handed back by take(). with HAVE_LIBURING the reads
+ * are queued on one io_uring served by a single io thread, otherwise a small
+ * DispatchQueue pool does plain pread. frames already in the decoded frame
+ * cache are skipped.
+ * */
+class MReadAhead{
+    private:
+        struct Item{
+            volatile int    state = 0;      //0 pending, 1 done, <0 error
+            std::string     fn;
+            int             fd = -1;
+            int             ownfd = 0;
+            uint64_t        off = 0;
+            uint32_t        size = 0;
+            JBuf            *buf = nullptr;
+            JMat            *mat = nullptr;
+            ~Item();
+        };
+        typedef std::shared_ptr<Item> ItemPtr;
+
+        int             m_depth = 0;
+        int             m_decode = 0;
+        int             m_maxitem = 0;
+        volatile int    m_quit = 0;
+        MFrameCache     *m_cache = nullptr;
+        std::mutex      *m_lock;
+        std::condition_variable         m_cond;
+        std::map<std::string,ItemPtr>   map_item;
+        std::deque<std::string>         que_key;
+        DispatchQueue   *m_pool = nullptr;
+
+        int     additem(const std::string& key,ItemPtr item);
+        int     takekey(const std::string& key,JMat* dst,int timeoutms);
+        void    evict();
+        int     readitem(ItemPtr item);
+        void    finish(ItemPtr item,int rst);
+#ifdef HAVE_LIBURING
+        struct io_uring     m_ring;
+        int                 m_uring = 0;
+        std::vector<ItemPtr>    vec_submit;
+        std::condition_variable m_subcond;
+        std::thread         m_iothread;
+        void    ioloop();
+#endif
+    public:
+        int     depth(){return m_depth;};
+        int     setCache(MFrameCache* cache);
+        int     prefetch(RolePack* pack,int frame,int planes = GPK_ALL);
+        int     prefetch(const std::string& fn);
+        int     take(int frame,int kind,JMat* dst,int timeoutms);
+        int     take(const std::string& fn,JMat* dst,int timeoutms);
+        void    clear();
+        MReadAhead(int depth,int decode = 0,int threads = 2);
+        virtual ~MReadAhead();
+};
@@ -0,0 +1,104 @@
+#include "renderahead.h"
+
+MRenderAhead::MRenderAhead(int workers,int size){
+    m_workers = workers<1?1:workers;
+    //two per worker so none idles while the loop copies a frame out
+    m_depth = m_workers*2;
+    m_size = size;
+    m_lock = new std::mutex();
+    m_pool = new DispatchQueue("RenderAhead",m_workers);
+}
+
+MRenderAhead::~MRenderAhead(){
+    clear();
+    delete m_pool;
+    m_pool = nullptr;
+    for(auto buf:vec_free)delete buf;
+    vec_free.clear();
+    delete m_lock;
+}
+
+JBuf* MRenderAhead::popbuf(){
+    if(vec_free.size()){
+        JBuf* buf = vec_free.back();
+        vec_free.pop_back();
+        return buf;
+    }
+    return new JBuf(m_size);
+}
+
+void MRenderAhead::pushbuf(JBuf* buf){
+    if(!buf)return;
+    if((int)vec_free.size()<m_depth){
+        vec_free.push_back(buf);
+    }else{
+        delete buf;
+    }
+}
+
+int MRenderAhead::submit(int index,const RenderFn& fn){
+    std::unique_lock<std::mutex> lock(*m_lock);
+    if(map_item.count(index))return 1;
+    if((int)map_item.size()>=m_depth)return 0;
+    ItemPtr item = std::make_shared<Item>();
+    item->buf = popbuf();
+    map_item[index] = item;
+    int gen = m_gen;
+    lock.unlock();
+    m_pool->dispatch([this,item,index,fn,gen](){
+        std::unique_lock<std::mutex> lock(*m_lock);
+        if(gen!=m_gen||item->dropped)return;
+        m_running++;
+        lock.unlock();
+        int rst = fn(index,(char*)item->buf->data(),m_size);
+        lock.lock();
+        item->rst = rst;
+        item->state = 1;
+        m_running--;
+        lock.unlock();
+        m_cond.notify_all();
+    });
+    return 1;
+}
+
+int MRenderAhead::take(int index,char* dstbuf,int timeoutms){
+    std::unique_lock<std::mutex> lock(*m_lock);
+    auto it = map_item.find(index);
+    if(it==map_item.end())return -1;
+    ItemPtr item = it->second;
+    if(!item->state){
+        m_cond.wait_for(lock,std::chrono::milliseconds(timeoutms),[&]{
+                return item->state;
+                });
+        if(!item->state){
+            //frees the window slot, a running job releases the buffer
+            //with the item when it finishes
+            item->dropped = 1;
+            map_item.erase(it);
+            return -2;
+        }
+    }
+    map_item.erase(it);
+    lock.unlock();
+    if(!item->rst)memcpy(dstbuf,item->buf->data(),m_size);
+    lock.lock();
+    pushbuf(item->buf);
+    item->buf = nullptr;
+    return item->rst;
+}
+
+void MRenderAhead::clear(){
+    m_pool->removePending();
+    std::unique_lock<std::mutex> lock(*m_lock);
+    m_gen++;
+    //buffers of running frames go with their items when the jobs finish
+    for(auto& kv:map_item){
+        ItemPtr item = kv.second;
+        if(item->state){
+            pushbuf(item->buf);
+            item->buf = nullptr;
+        }
+    }
+    map_item.clear();
+    m_cond.wait(lock,[this]{return m_running<=0;});
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "jmat.h"
+#include "dispatchqueue.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+/*
+ * render-ahead of lip-sync frames
+ *
+ * once the bnf features of a wav exist every audio index renders
+ * independently, so the render loop submits the next indices and K worker
+ * threads render them concurrently into their own buffers; take() hands the
+ * frames back in index order. the workers share the role's ncnn::Net, each
+ * inference runs on its own extractor.
+ * */
+class MRenderAhead{
+    public:
+        //renders audio index into dstbuf, returns 0 or a GDigit error code
+        typedef std::function<int(int index,char* dstbuf,int size)> RenderFn;
+    private:
+        struct Item{
+            volatile int    state = 0;      //0 pending, 1 done
+            int             rst = 0;
+            int             dropped = 0;    //given up by take, do not start
+            JBuf            *buf = nullptr;
+            ~Item(){if(buf)delete buf;};
+        };
+        typedef std::shared_ptr<Item> ItemPtr;
+
+        int             m_workers = 0;
+        int             m_depth = 0;
+        int             m_size = 0;
+        int             m_running = 0;
+        //bumped by clear, queued jobs of an older generation do not start
+        int             m_gen = 0;
+        std::mutex      *m_lock;
+        std::condition_variable     m_cond;
+        std::map<int,ItemPtr>       map_item;
+        std::vector<JBuf*>          vec_free;
+        DispatchQueue   *m_pool = nullptr;
+
+        JBuf*   popbuf();
+        void    pushbuf(JBuf* buf);
+    public:
+        int     workers(){return m_workers;};
+        //frames kept in flight ahead of the one being taken
+        int     depth(){return m_depth;};
+        //queue index unless it is already queued, false when the window is full
+        int     submit(int index,const RenderFn& fn);
+        //wait for index and copy it to dstbuf, returns its render result;
+        //-1 when index was never queued, -2 on timeout, either way index
+        //leaves the window and the caller renders it itself
+        int     take(int index,char* dstbuf,int timeoutms);
+        //drop queued frames and wait for running ones, call before the
+        //features they read are replaced
+        void    clear();
+        //size: bytes of one output frame
+        MRenderAhead(int workers,int size);
+        virtual ~MRenderAhead();
+};
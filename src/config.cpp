@@ -20,3 +20,41 @@ bool config::valid() {
   check(lmPrompt);
   return groupId.size() > 0 and apiKey.size() > 0;
 }
+
+// conf.json中的可调参数, 没有的键保留默认值
+void config::load(const nlohmann::json &root) {
+  frameCacheMB = root.value("frameCacheMB", frameCacheMB);
+  frameCachePreload = root.value("frameCachePreload", frameCachePreload);
+  readAheadFrames = root.value("readAheadFrames", readAheadFrames);
+  readAheadDecode = root.value("readAheadDecode", readAheadDecode);
+  roiDecode = root.value("roiDecode", roiDecode);
+  roleFaces = root.value("roleFaces", roleFaces);
+  renderWorkers = root.value("renderWorkers", renderWorkers);
+  renderBatch = root.value("renderBatch", renderBatch);
+  inferWorkers = root.value("inferWorkers", inferWorkers);
+  inferWindowUs = root.value("inferWindowUs", inferWindowUs);
+  inferMaxBatch = root.value("inferMaxBatch", inferMaxBatch);
+  inferDeadlineMs = root.value("inferDeadlineMs", inferDeadlineMs);
+  munetInt8 = root.value("munetInt8", munetInt8);
+  munetStorage = root.value("munetStorage", munetStorage);
+  munetArith = root.value("munetArith", munetArith);
+  munetFlat = root.value("munetFlat", munetFlat);
+  alphaStorage = root.value("alphaStorage", alphaStorage);
+  alphaArith = root.value("alphaArith", alphaArith);
+  alphaFlat = root.value("alphaFlat", alphaFlat);
+  idleCacheMB = root.value("idleCacheMB", idleCacheMB);
+  arenaMB = root.value("arenaMB", arenaMB);
+  arenaHugePages = root.value("arenaHugePages", arenaHugePages);
+  preloadRoles = root.value("preloadRoles", preloadRoles);
+  warmupRuns = root.value("warmupRuns", warmupRuns);
+  ortGraphOpt = root.value("ortGraphOpt", ortGraphOpt);
+  ortIntraThreads = root.value("ortIntraThreads", ortIntraThreads);
+  ortInterThreads = root.value("ortInterThreads", ortInterThreads);
+  ortMemArena = root.value("ortMemArena", ortMemArena);
+  ortMemPattern = root.value("ortMemPattern", ortMemPattern);
+  ortCacheDir = root.value("ortCacheDir", ortCacheDir);
+  shmWeights = root.value("shmWeights", shmWeights);
+  resUrl = root.value("resUrl", resUrl);
+  cdnUrl = root.value("cdnUrl", cdnUrl);
+  installWindow = root.value("installWindow", installWindow);
+}
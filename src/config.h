@@ -1,6 +1,8 @@
 #pragma once
 #include <map>
+#include <nlohmann/json.hpp>
 #include <string>
+#include <vector>
 
 class config {
 private:
@@ -9,6 +11,7 @@ private:
 public:
   static config *get();
   bool valid();
+  void load(const nlohmann::json &root);
   std::string groupId = "";
   std::string apiKey = "";
   // std::string lmUrl = "https://api.deepseek.com/chat/completions";
@@ -20,6 +23,66 @@ public:
   std::string lmPrompt =
       "你是一个智能助手,性格可爱,善于助人,每次回复要求：口语化的回复,"
       "不要使用mardown的标记格式,不要带表情包，不要超过30个字";
+  // 解码帧缓存预算(MB), 0为关闭; preload为true时加载角色即全部解码
+  int frameCacheMB = 0;
+  bool frameCachePreload = false;
+  // 预读后续帧数, 0为关闭; decode为true时预读线程同时完成解码
+  int readAheadFrames = 0;
+  bool readAheadDecode = false;
+  // 每个会话并行渲染说话帧的线程数, 共享同一个ncnn::Net, 按序输出; 0或1为在渲染线程内逐帧渲染
+  int renderWorkers = 0;
+  // 离线合成(render)时有pack的角色每批一起推理的帧数, 0或1为逐帧
+  int renderBatch = 0;
+  // 全机共享的munet推理服务: inferWorkers个工作线程(各分big核/inferWorkers个线程)
+  // 按模型聚批, 最早的请求等待inferWindowUs或凑满inferMaxBatch即执行,
+  // 不会等到错过inferDeadlineMs; 0为关闭, 会话在自己的线程推理
+  int inferWorkers = 0;
+  int inferWindowUs = 2000;
+  int inferMaxBatch = 8;
+  int inferDeadlineMs = 40;
+  // 角色目录有munetquant生成的int8模型(qb/qp)时用int8推理
+  bool munetInt8 = false;
+  // ncnn模型精度, 写入角色的ncnnConfig交给GDigit::config:
+  // Storage为权重和中间结果的存储精度, Arith为计算精度, 取"fp32","fp16","bf16", 空为ncnn默认;
+  // Flat为true时不用simd打包布局(elempack为1)
+  std::string munetStorage = "";
+  std::string munetArith = "";
+  bool munetFlat = false;
+  std::string alphaStorage = "";
+  std::string alphaArith = "";
+  bool alphaFlat = false;
+  // 有前景图(raw_sg)时说话帧的原图只解码人脸框所在的MCU块
+  bool roiDecode = false;
+  // 角色pack旁的frames.gfc(每帧人脸框裁剪缩放到168的结果), 说话帧直接用它, 不再裁剪缩放,
+  // 有前景图时原图也不解码: 0关闭, 1存在且与pack一致时使用, 2缺失或过期时加载角色时生成
+  int roleFaces = 1;
+  // 空闲帧RGBA发送数据缓存预算(MB), 0为关闭
+  int idleCacheMB = 0;
+  // 帧缓冲, 特征缓存和ncnn张量的大块内存从arena分配, 预留arenaMB地址空间, 0为关闭;
+  // arenaHugePages 1为透明大页(madvise), 2为hugetlbfs大页池(不足时退回透明大页)
+  int arenaMB = 0;
+  int arenaHugePages = 1;
+  // 加密模型解密后放到/dev/shm共享映射, 同机多个进程映射同一份文件;
+  // ncnn建pipeline时大部分卷积权重仍会重排到进程私有内存, 实际节省以PSS为准.
+  // 明文会留在/dev/shm, 默认关闭, 关闭时在各进程内存中解密
+  bool shmWeights = false;
+  // wenet的onnxruntime选项: 图优化级别(0/1/2/99), 线程数(0为默认), 内存arena和内存复用;
+  // ortCacheDir非空时把优化后的模型按模型hash存为ORT格式, 之后直接加载跳过优化;
+  // 缓存是未加密的模型, 默认关闭, 开启后目录为0700, 文件为0600
+  int ortGraphOpt = 99;
+  int ortIntraThreads = 0;
+  int ortInterThreads = 0;
+  bool ortMemArena = true;
+  bool ortMemPattern = true;
+  std::string ortCacheDir = "";
+  // 启动时预加载并常驻的角色, 每个角色先做warmupRuns次空推理
+  std::vector<std::string> preloadRoles;
+  int warmupRuns = 2;
+  // 公共资源下载地址; cdnUrl非空时所有zip改从cdnUrl下的同名文件下载(如本地测试服务)
+  std::string resUrl = "https://cdn.guiji.ai/duix/location/gj_dh_res.zip";
+  std::string cdnUrl = "";
+  // 流式安装角色时, 模型和前installWindow帧到齐即可开始渲染, 0为等全部装完
+  int installWindow = 25;
   std::map<std::string, std::string> roles = {
       {"Andrew", "https://digital-public.obs.cn-east-3.myhuaweicloud.com/"
                  "dhp-tools/dhp-tools/651705983152197/61025/"
@@ -6,9 +6,10 @@
     > Created Time: 2025年03月11日 星期二 22时50分37秒
  ************************************************************************/
 
-#include "aesmain.h"
 #include "block_queue.h"
 #include "config.h"
+#include "role_fetch.h"
+#include "role_registry.h"
 #include "tts.h"
 #include "util.h"
 #include <arpa/inet.h>
@@ -16,6 +17,8 @@
 #include <edge_render.h>
 #include <filesystem>
 #include <fstream>
+#include <jarena.h>
+#include <munetservice.h>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <opencv2/opencv.hpp>
@@ -27,18 +30,6 @@ namespace fs = std::filesystem;
 using json = nlohmann::json;
 
 EdgeRender::EdgeRender() {
-  _baseMD5Map = {{"alpha_model.b", "ab"},
-                 {"alpha_model.p", "ap"},
-                 {"cacert.p", "cp"},
-                 {"weight_168u.b", "wb"},
-                 {"wenet.o", "wo"}};
-  _modelMD5Map = {{"dh_model.b", "db"},
-                  {"dh_model.p", "dp"},
-                  {"bbox.j", "bj"},
-                  {"config.j", "cj"},
-                  {"weight_168u.b", "wb"}
-
-  };
   _done.store(false);
   _imgHdl = nullptr;
   _ttsTasks.name = "TTS_TASK_QUEUE";
@@ -58,10 +49,10 @@ void EdgeRender::startRender() {
         const std::chrono::milliseconds frameDuration(40); // 25fps
         while (done() == false) {
             auto frameStart = std::chrono::steady_clock::now();
-            std::shared_ptr<std::vector<uint8_t>> rgba;
-            bool ret = _frames.try_pop(rgba);
+            std::shared_ptr<WireFrame> wire;
+            bool ret = _frames.try_pop(wire);
             if (ret) {
-                _imgHdl(*rgba);
+                _imgHdl(*wire);
             }
             auto frameEnd = std::chrono::steady_clock::now();
             auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(frameEnd - frameStart);
@@ -90,16 +81,23 @@ void EdgeRender::startRender() {
         int buf_index = 0;
         std::string current_wav = "";
         bool speaking = false; // State to track if we are currently animating speech
+        cv::Mat mat;
 
         while (done() == false) {
-            cv::Mat mat = cv::Mat(_modelInfo._height, _modelInfo._width, CV_8UC3);
-            cv::Mat mskmat = cv::Mat(_modelInfo._height, _modelInfo._width, CV_8UC3);
-            
-            if (_modelInfo._frames.empty()) {
+            size_t count = frameCount();
+            if (count == 0) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
                 continue;
             }
-            Frame frame = _modelInfo._frames[i++ % _modelInfo._frames.size()];
+            mat.create(_modelInfo->_height, _modelInfo->_width, CV_8UC3);
+            IdlePayloadCache::Body body;
+            // 画帧失败时mat是旧内容, 照常发出但不进空闲缓存
+            int drawn = 0;
+            // 帧数增长时从当前位置继续, 不跳帧
+            size_t pos = i % count;
+            Frame frame = frameAt(pos);
+            i = pos + 1;
+            prefetch(i);
 
             json metadata;
             metadata["timestamp"] = getCurrentTime();
@@ -108,16 +106,26 @@ void EdgeRender::startRender() {
             if (speaking && buf_index < all_buf) {
                 // --- STATE 1: Currently Speaking ---
                 // Render the lip-synced animation frame by frame.
-                if (_modelInfo._hasMask) {
-                    _digit->mskrstbuf(buf_index++, frame._rawPath.c_str(), frame.rect,
-                                      frame._maskPath.c_str(), frame._sgPath.c_str(),
-                                      reinterpret_cast<char *>(mat.data),
-                                      reinterpret_cast<char *>(mskmat.data),
-                                      _modelInfo._width * _modelInfo._height * 3);
+                if (_renderahead) {
+                    // 后续帧交给工作线程并行渲染, 这里按序取回
+                    for (int d = 0; d < _renderahead->depth() && buf_index + d < all_buf; ++d) {
+                        Frame next = frameAt((pos + d) % count);
+                        auto fn = [this, next](int index, char *dst, int) {
+                            return renderSpeech(index, next, dst);
+                        };
+                        if (!_renderahead->submit(buf_index + d, fn)) {
+                            break;
+                        }
+                    }
+                    int ret = _renderahead->take(buf_index, reinterpret_cast<char *>(mat.data), 1000);
+                    if (ret != 0) {
+                        // 没排上, 超时或渲染失败时mat里是旧帧, 在本线程重画这一帧
+                        PLOGE << "render ahead frame " << buf_index << " failed:" << ret;
+                        renderSpeech(buf_index, frame, reinterpret_cast<char *>(mat.data));
+                    }
+                    buf_index++;
                 } else {
-                    _digit->onerstbuf(buf_index++, frame._rawPath.c_str(), frame.rect,
-                                      reinterpret_cast<char *>(mat.data),
-                                      _modelInfo._height * _modelInfo._width * 3);
+                    renderSpeech(buf_index++, frame, reinterpret_cast<char *>(mat.data));
                 }
                 // This correctly generates the URL
                 metadata["wav"] = "http://localhost:8080/audio/" + getBaseName(current_wav);
@@ -127,6 +135,9 @@ void EdgeRender::startRender() {
                     // --- STATE 2: Just Finished Speaking ---
                     // This correctly sends the "listen" signal to continue the conversation.
                     PLOGI << "Finished speaking. Sending listen signal.";
+                    if (_renderahead) {
+                        _renderahead->clear();
+                    }
                     metadata["listen"] = 1;
                     speaking = false;
                     current_wav = "";
@@ -138,6 +149,10 @@ void EdgeRender::startRender() {
                 if (_wavs.try_pop(current_wav)) {
                     if (!current_wav.empty()) {
                         Timer t("feat extreact: " + current_wav);
+                        // 换特征前等工作线程停下
+                        if (_renderahead) {
+                            _renderahead->clear();
+                        }
                         all_buf = _digit->newwav(current_wav.c_str(), "");
                         buf_index = 0;
                         if (all_buf > 0) {
@@ -151,223 +166,255 @@ void EdgeRender::startRender() {
                 } else {
                     // --- STATE 4: Idle ---
                     // Renders the idle animation when nothing else is happening.
-                     _digit->drawonebuf(frame._rawPath.c_str(),
-                                       reinterpret_cast<char *>(mat.data),
-                                       _modelInfo._height * _modelInfo._width * 3);
+                    // 空闲帧每轮都相同, 命中缓存时直接复用已转换好的RGBA
+                    if (_assets->idle) {
+                        body = _assets->idle->get(frame.index - 1);
+                    }
+                    if (body) {
+                    } else if (_assets->pack) {
+                        drawn = _digit->drawonepack(frame.index - 1,
+                                                    reinterpret_cast<char *>(mat.data),
+                                                    _modelInfo->_height * _modelInfo->_width * 3);
+                    } else {
+                        drawn = _digit->drawonebuf(frame._rawPath.c_str(),
+                                                   reinterpret_cast<char *>(mat.data),
+                                                   _modelInfo->_height * _modelInfo->_width * 3);
+                    }
+                    if (drawn != 0) {
+                        PLOGE << "draw idle frame " << frame.index << " failed:" << drawn;
+                    }
                 }
             }
 
-            cv::Mat rgba;
-            cv::cvtColor(mat, rgba, cv::COLOR_BGR2RGBA);
+            if (!body) {
+                auto rgba = std::make_shared<std::vector<uint8_t>>(mat.total() * 4);
+                cv::Mat rgbaMat(mat.rows, mat.cols, CV_8UC4, rgba->data());
+                cv::cvtColor(mat, rgbaMat, cv::COLOR_BGR2RGBA);
+                body = rgba;
+                if (!speaking && drawn == 0 && _assets->idle) {
+                    body = _assets->idle->put(frame.index - 1, body);
+                }
+            }
 
             std::string metadata_str = metadata.dump();
-            
+
             uint32_t metadata_length = static_cast<uint32_t>(metadata_str.size());
-            auto message_buffer = std::make_shared<std::vector<uint8_t>>();
+            auto wire = std::make_shared<WireFrame>();
             uint32_t net_length = htonl(metadata_length);
-            
-            message_buffer->insert(message_buffer->end(),
-                                   reinterpret_cast<uint8_t *>(&net_length),
-                                   reinterpret_cast<uint8_t *>(&net_length) + 4);
-            message_buffer->insert(message_buffer->end(), metadata_str.begin(), metadata_str.end());
-            message_buffer->insert(message_buffer->end(), rgba.data, rgba.data + (rgba.rows * rgba.cols * rgba.channels()));
-            _frames.push(message_buffer);
+
+            wire->head.reserve(4 + metadata_str.size());
+            wire->head.insert(wire->head.end(),
+                              reinterpret_cast<uint8_t *>(&net_length),
+                              reinterpret_cast<uint8_t *>(&net_length) + 4);
+            wire->head.insert(wire->head.end(), metadata_str.begin(), metadata_str.end());
+            wire->body = body;
+            _frames.push(wire);
         }
     });
 }
 
 
-int EdgeRender::checkModel(const std::string &role) {
-  static std::mutex mx;
-  std::lock_guard<std::mutex> lock(mx);
-
-    const std::string basePath = "/app/";
-
-    // 2. Create absolute paths for the model directory and the zip file.
-    fs::path modelDir = basePath + "gj_dh_res";
-    fs::path zipFile = basePath + "gj_dh_res.zip";
-    std::string url = "https://cdn.guiji.ai/duix/location/gj_dh_res.zip";
-    
-  
-    if (fs::exists(modelDir) == false) {
-    PLOGI << "Resource directory not found at " << modelDir << ". Downing...";
-    
-    // 4. Build a robust command that downs and unzips to the absolute path.
-    //    - `wget -O`: Specifies the exact output file path.
-    //    - `unzip -d`: Specifies the directory to extract files into.
-    //    - `rm`: Cleans up the downed zip file.
-    std::string cmd = "wget " + url + " -O " + zipFile.string() +
-                      " && unzip " + zipFile.string() + " -d " + basePath +
-                      " && rm " + zipFile.string();
-
-    // Execute the command
-    int ret = std::system(cmd.c_str());
-    if (ret != 0 || fs::exists(modelDir) == false) {
-        PLOGI << "Failed to download or extract resources. Command was: " << cmd;
-        return -1;
-    }
-    PLOGI << "Resources downloaded successfully.";
-}
-
+int EdgeRender::checkModel(const std::string &role, const RoleFetcher::ProgressCb &cb,
+                           std::shared_ptr<RoleInstall> *live) {
+  const std::string basePath = "/app/";
   auto conf = config::get();
+  auto fetcher = RoleFetcher::get();
+
+  // 公共资源和各角色分别单飞下载, 已在磁盘上的直接返回
+  std::string url = RoleFetcher::mirror(conf->resUrl);
+  int ret = fetcher->ensure("gj_dh_res", url, basePath + "gj_dh_res", "gj_dh_res", cb);
+  if (ret != 0) {
+    PLOGE << "Failed to fetch resources from " << url << " ret:" << ret;
+    return -1;
+  }
+
   if (conf->roles.count(role) == 0) {
     PLOGI << "Not support role: " << role << " use default role";
     url = conf->roles["XiaoXuan"];
   } else {
     url = conf->roles[role];
   }
+  url = RoleFetcher::mirror(url);
+
+  // zip内的目录名即zip文件名去掉.zip
+  std::string zipName = fs::path(url).filename();
+  std::string roleName = zipName.substr(0, zipName.length() - 4);
+  fs::path roleDir = fs::path(basePath) / "roles" / role;
+  ret = fetcher->ensure("roles/" + role, url, roleDir.string(), roleName, cb, live);
+  if (ret != 0) {
+    PLOGE << "Failed to fetch role " << role << " from " << url << " ret:" << ret;
+    return -2;
+  }
+  return 0;
+}
 
-fs::path roleDir = fs::path(basePath) / "roles" / role;
-if (fs::exists(roleDir) == false) {
-    PLOGI << "Role not found at " << roleDir << ". Downloading...";
-    
-    // Ensure the base roles directory exists
-    fs::create_directories(fs::path(basePath) / "roles");
-
-    std::string zipName = fs::path(url).filename();
-    fs::path zipFile = fs::path(basePath) / zipName;
-    std::string roleName = zipName.substr(0, zipName.length() - 4);
-    fs::path extractedRolePath = fs::path(basePath) / roleName;
-
-    // Build a robust command using absolute paths
-    std::string cmd = "wget " + url + " -O " + zipFile.string() +
-                      " && unzip " + zipFile.string() + " -d " + basePath +
-                      " && mv " + extractedRolePath.string() + " " + roleDir.string() +
-                      " && rm " + zipFile.string();
-                      
-    int ret = std::system(cmd.c_str());
-    if (ret != 0 || !fs::exists(roleDir)) {
-        PLOGI << "Failed to download role. Command was: " << cmd;
-        return -2;
+void EdgeRender::preload(const std::vector<std::string> &roles, int warmup) {
+    if (roles.empty()) {
+        return;
     }
-    PLOGI << "Role downloaded successfully to " << roleDir;
+    std::thread([roles, warmup]() {
+        for (const auto &role : roles) {
+            Timer t("preload role: " + role);
+            int ret = checkModel(role);
+            if (ret == 0) {
+                ret = RoleRegistry::get()->preload(role, warmup);
+            }
+            PLOGI << "preload role:" << role << " ret:" << ret;
+        }
+    }).detach();
 }
 
-  return 0;
+std::string EdgeRender::stats() {
+    json root;
+    munetsvc_stat svc;
+    MunetService::get()->stat(&svc);
+    json infer;
+    infer["workers"] = svc.workers;
+    infer["threads"] = svc.threads;
+    infer["requests"] = svc.requests;
+    infer["batches"] = svc.batches;
+    infer["pending"] = svc.pending;
+    infer["deadlineMisses"] = svc.misses;
+    infer["avgCostMs"] = svc.avgcost;
+    json batch = json::object();
+    for (int n = 1; n <= MUNETSVC_BATCHES; ++n) {
+        if (svc.batchhist[n]) {
+            batch[(n == MUNETSVC_BATCHES ? ">=" : "") + std::to_string(n)] = svc.batchhist[n];
+        }
+    }
+    infer["batchSize"] = batch;
+    json wait = json::object();
+    for (int k = 0; k < MUNETSVC_WAITS; ++k) {
+        std::string key = munetsvc_waitms[k] ? "<" + std::to_string(munetsvc_waitms[k]) + "ms"
+                                             : ">=" + std::to_string(munetsvc_waitms[k - 1]) + "ms";
+        wait[key] = svc.waithist[k];
+    }
+    infer["waitTime"] = wait;
+    root["infer"] = infer;
+
+    jarena_stat st;
+    if (JArena::get()->mode() != JARENA_OFF && JArena::get()->stat(&st) == 0) {
+        json arena;
+        arena["mappedMB"] = st.mapped >> 20;
+        arena["inuseMB"] = st.inuse >> 20;
+        arena["hugeMB"] = st.huge >> 20;
+        arena["fallbacks"] = st.fallbacks;
+        root["arena"] = arena;
+    }
+    root["roles"] = RoleRegistry::get()->size();
+    return root.dump();
 }
 
 int EdgeRender::load(const std::string &role) {
-    // --- FIX START ---
-    // Define the absolute base path for all resources.
-    const std::string basePath = "/app/";
-    // Construct absolute paths for the resource directories.
-    std::string baseDir = basePath + "gj_dh_res";
-    std::string modelDir = basePath + "roles/" + role;
-    // --- FIX END ---
-
-    if (checkModel(role) != 0) {
+    // 等待下载时把进度推给客户端
+    auto progress = [this, role](const std::string &stage, int percent) {
+        if (_msgHdl) {
+            json msg;
+            msg["event"] = "role_progress";
+            msg["role"] = role;
+            msg["stage"] = stage;
+            msg["percent"] = percent;
+            _msgHdl(msg.dump());
+        }
+    };
+    std::shared_ptr<RoleInstall> live;
+    if (checkModel(role, progress, &live) != 0) {
         return -1;
     };
 
-    // The rest of the function now works correctly because all file operations
-    // below use the corrected absolute paths defined in `baseDir` and `modelDir`.
-    for (const auto &p : _baseMD5Map) {
-        auto &key = p.first;
-        auto &value = p.second;
-        fs::path file = fs::path(baseDir) / value;
-        if (fs::exists(file) == false) {
-            fs::path newFile = fs::path(baseDir) / key;
-            PLOGI << "convert " << newFile.string() << " to " << file.string();
-            if (!fs::exists(newFile)) {
-                PLOGI << "cant find " << newFile.string();
-                return -1;
-            }
-            int ret = mainenc(0, const_cast<char *>(newFile.string().c_str()),
-                              const_cast<char *>(file.string().c_str()));
-            PLOGI << "convert result:" << ret;
-        }
+    int ret = RoleRegistry::get()->acquire(role, _assets, live);
+    if (ret != 0) {
+        return ret;
     }
-    for (const auto &p : _modelMD5Map) {
-        auto &key = p.first;
-        auto &value = p.second;
-        fs::path file = fs::path(modelDir) / value;
-        if (fs::exists(file) == false) {
-            fs::path newFile = fs::path(modelDir) / key;
-            PLOGI << "convert " << newFile.string() << " to " << file.string();
-            if (!fs::exists(newFile)) {
-                PLOGI << "cant find " << newFile.string();
-                return -1;
-            }
-            int ret = mainenc(0, const_cast<char *>(newFile.string().c_str()),
-                              const_cast<char *>(file.string().c_str()));
-            PLOGI << "convert result:" << ret;
-        }
-    }
-
-    std::ifstream bbox(fs::path(modelDir) / _modelMD5Map["bbox.j"]);
-    json boxJson = json::parse(bbox);
+    _modelInfo = &_assets->info;
 
-    std::ifstream config(fs::path(modelDir) / _modelMD5Map["config.j"]);
-    json configJson = json::parse(config);
-
-    _modelInfo._hasMask = configJson.value("need_png", 0) == 0 &&
-                          fs::exists(fs::path(modelDir) / "raw_jpgs") &&
-                          fs::exists(fs::path(modelDir) / "raw_sg") &&
-                          fs::exists(fs::path(modelDir) / "pha");
-
-    PLOGI << "hasMask:" << _modelInfo._hasMask;
-    for (int i = 1;; ++i) {
-        auto rawPath = fs::path(modelDir) / "raw_jpgs" / (std::to_string(i) + ".sij");
-        auto maskPath = fs::path(modelDir) / "pha" / (std::to_string(i) + ".sij");
-        auto sgPath = fs::path(modelDir) / "raw_sg" / (std::to_string(i) + ".sij");
-        if (fs::exists(rawPath) == false) {
-            break;
-        }
-        Frame frame;
-        frame.index = i;
-        frame._rawPath = rawPath.string();
-        if (_modelInfo._hasMask && fs::exists(maskPath)) {
-            frame._maskPath = maskPath.string();
-        }
-        if (_modelInfo._hasMask && fs::exists(sgPath)) {
-            frame._sgPath = sgPath.string();
-        }
-        if (boxJson.count(std::to_string(i))) {
-            frame.rect[0] = boxJson[std::to_string(i)][0];
-            frame.rect[1] = boxJson[std::to_string(i)][2];
-            frame.rect[2] = boxJson[std::to_string(i)][1];
-            frame.rect[3] = boxJson[std::to_string(i)][3];
-        }
-        _modelInfo._frames.push_back(frame);
+    MessageCb *cb = nullptr;
+    _digit = std::make_unique<GDigit>(_modelInfo->_width, _modelInfo->_height, cb);
+    _digit->setPack(_assets->pack.get());
+    _digit->setFaces(_assets->faces.get());
+    _digit->setCache(_assets->cache.get());
+
+    auto conf = config::get();
+    _digit->setRoiDecode(conf->roiDecode);
+    if (conf->readAheadFrames > 0) {
+        _readahead = std::make_unique<MReadAhead>(conf->readAheadFrames, conf->readAheadDecode);
+        _readahead->setCache(_assets->cache.get());
+        _digit->setReadAhead(_readahead.get());
     }
-    if (_modelInfo._frames.size() == 0) {
-        return -2;
+    _digit->shareWenet(_assets->wenet.get());
+    // 网络和权重按角色共享, 会话只持有自己的Mobunet
+    _digit->shareMunet(new Mobunet(_assets->munet), 1);
+    if (conf->renderWorkers > 1) {
+        _renderahead = std::make_unique<MRenderAhead>(conf->renderWorkers,
+                                                      _modelInfo->_width * _modelInfo->_height * 3);
+        PLOGI << "render workers:" << conf->renderWorkers
+              << " threads each:" << _digit->setWorkers(conf->renderWorkers);
     }
 
-    _modelInfo._width = configJson.value("width", 0);
-    _modelInfo._height = configJson.value("height", 0);
-
-    json ncnnConfig;
-    ncnnConfig["action"] = 1;
-    ncnnConfig["videowidth"] = _modelInfo._width;
-    ncnnConfig["videoheight"] = _modelInfo._height;
-    ncnnConfig["timeoutms"] = 5000;
-    ncnnConfig["wenetfn"] = fs::path(baseDir) / "wo";
-    if (fs::exists(fs::path(modelDir) / "wb")) {
-        PLOGI << "使用模型自带的weight:" << fs::path(modelDir) / "wb";
-        ncnnConfig["unetmsk"] = fs::path(modelDir) / "wb";
-    } else {
-        ncnnConfig["unetmsk"] = fs::path(baseDir) / "wb";
+    PLOGI << "digit config:" << _digit->config(_modelInfo->_ncnnConfig.c_str());
+    _digit->start();
+    PLOGI << "width:" << _modelInfo->_width << " height:" << _modelInfo->_height
+          << " roles:" << RoleRegistry::get()->size();
+    PLOGI << "模型初始化完成";
+    jarena_stat st;
+    if (JArena::get()->mode() != JARENA_OFF && JArena::get()->stat(&st) == 0) {
+        PLOGI << "arena mapped:" << (st.mapped >> 20) << "MB inuse:" << (st.inuse >> 20)
+              << "MB huge:" << (st.huge >> 20) << "MB fallbacks:" << st.fallbacks;
     }
-    ncnnConfig["cacertfn"] = fs::path(baseDir) / "cp";
-    ncnnConfig["alphabin"] = fs::path(baseDir) / "ab";
-    ncnnConfig["alphaparam"] = fs::path(baseDir) / "ap";
 
-    ncnnConfig["unetbin"] = fs::path(modelDir) / "db";
-    ncnnConfig["unetparam"] = fs::path(modelDir) / "dp";
-    PLOGI << "ncnnConfig:" << ncnnConfig.dump();
+    return 0;
+}
 
-    _modelInfo._ncnnConfig = ncnnConfig.dump();
+size_t EdgeRender::frameCount() {
+    if (_assets && _assets->pack) {
+        return _assets->pack->frames();
+    }
+    return _modelInfo ? _modelInfo->_frames.size() : 0;
+}
 
-    MessageCb *cb = nullptr;
-    _digit = std::make_unique<GDigit>(_modelInfo._width, _modelInfo._height, cb);
+Frame EdgeRender::frameAt(size_t k) {
+    if (!_assets->pack) {
+        return _modelInfo->_frames[k];
+    }
+    Frame frame;
+    frame.index = k + 1;
+    const int *box = _assets->pack->box(k);
+    for (int j = 0; box && j < 4; ++j) {
+        frame.rect[j] = box[j];
+    }
+    return frame;
+}
 
-    PLOGI << "digit config:" << _digit->config(_modelInfo._ncnnConfig.c_str());
-    _digit->start();
-    PLOGI << "width:" << _modelInfo._width << " height:" << _modelInfo._height;
-    PLOGI << "模型初始化完成";
+int EdgeRender::renderSpeech(int index, const Frame &frame, char *dst) {
+    int size = _modelInfo->_width * _modelInfo->_height * 3;
+    if (_assets->pack && _modelInfo->_hasMask) {
+        return _digit->mskrstpack(index, frame.index - 1, dst, nullptr, size, kRenderPlanes);
+    } else if (_assets->pack) {
+        return _digit->onerstpack(index, frame.index - 1, dst, size);
+    } else if (_modelInfo->_hasMask) {
+        int rect[4] = {frame.rect[0], frame.rect[1], frame.rect[2], frame.rect[3]};
+        return _digit->mskrstbuf(index, frame._rawPath.c_str(), rect, frame._maskPath.c_str(),
+                                 frame._sgPath.c_str(), dst, nullptr, size, kRenderPlanes);
+    }
+    int rect[4] = {frame.rect[0], frame.rect[1], frame.rect[2], frame.rect[3]};
+    return _digit->onerstbuf(index, frame._rawPath.c_str(), rect, dst, size);
+}
 
-    return 0;
+// 帧顺序是固定轮转的, 提前把后续几帧交给预读
+void EdgeRender::prefetch(int next) {
+    size_t count = frameCount();
+    if (!_readahead || count == 0) {
+        return;
+    }
+    for (int k = 0; k < _readahead->depth(); ++k) {
+        const Frame frame = frameAt((next + k) % count);
+        if (_assets->pack) {
+            _readahead->prefetch(_assets->pack.get(), frame.index - 1, kRenderPlanes);
+        } else {
+            _readahead->prefetch(frame._rawPath);
+            _readahead->prefetch(frame._sgPath);
+        }
+    }
 }
 
 std::string EdgeRender::render(const std::string &input) {
@@ -384,51 +431,67 @@ std::string EdgeRender::render(const std::string &input) {
   double wavDuration = durationMs(wav);
   PLOGI << "buf_len:" << all_buf << " wav_len:" << wavDuration;
 
-  cv::Mat mat = cv::Mat(_modelInfo._height, _modelInfo._width, CV_8UC3);
-  cv::Mat mskmat = cv::Mat(_modelInfo._height, _modelInfo._width, CV_8UC3);
-  for (int i = 0; i * 40 < wavDuration; ++i) {
-    Frame frame = _modelInfo._frames[i % _modelInfo._frames.size()];
-
-    if (_modelInfo._hasMask) {
-      _digit->mskrstbuf(i, frame._rawPath.c_str(), frame.rect,
-                        frame._maskPath.c_str(), frame._sgPath.c_str(),
-                        reinterpret_cast<char *>(mat.data),
-                        reinterpret_cast<char *>(mskmat.data),
-                        _modelInfo._width * _modelInfo._height * 3);
-
-      // _digit->drawmskbuf(frame._rawPath.c_str(), frame._maskPath.c_str(),
-      //                    reinterpret_cast<char *>(mat.data),
-      //                    reinterpret_cast<char *>(mskmat.data),
-      //                    _modelInfo._height * _modelInfo._width * 3);
-
+  int frames = 0;
+  while (frames * 40 < wavDuration) {
+    ++frames;
+  }
+  // 有pack时每renderBatch帧一起推理, 按序输出
+  int batch = std::max(1, config::get()->renderBatch);
+  std::vector<cv::Mat> mats(batch);
+  for (auto &m : mats) {
+    m.create(_modelInfo->_height, _modelInfo->_width, CV_8UC3);
+  }
+  std::vector<int> packFrames(batch);
+  std::vector<char *> dsts(batch);
+  for (int i = 0; i < frames;) {
+    int n = 1;
+    if (batch > 1 && _assets->pack && i < all_buf) {
+      n = std::min({batch, all_buf - i, frames - i});
+    }
+    if (n > 1) {
+      for (int k = 0; k < n; ++k) {
+        packFrames[k] = frameAt((i + k) % frameCount()).index - 1;
+        dsts[k] = reinterpret_cast<char *>(mats[k].data);
+      }
+      prefetch(i + n);
+      int ret = _digit->rstpackbatch(i, n, packFrames.data(), dsts.data(),
+                                     _modelInfo->_width * _modelInfo->_height * 3,
+                                     _modelInfo->_hasMask, kRenderPlanes);
+      if (ret != 0) {
+        PLOGE << "batch render at " << i << " failed:" << ret;
+      }
     } else {
-      _digit->onerstbuf(i, frame._rawPath.c_str(), frame.rect,
-                        reinterpret_cast<char *>(mat.data),
-                        _modelInfo._height * _modelInfo._width * 3);
+      Frame frame = frameAt(i % frameCount());
+      prefetch(i + 1);
+      renderSpeech(i, frame, reinterpret_cast<char *>(mats[0].data));
     }
 
+    for (int k = 0; k < n; ++k, ++i) {
+      cv::Mat &mat = mats[k];
+
 #if 0
-    cv::Point topLeft(frame.rect[0], frame.rect[1]);
-    cv::Point bottomRight(frame.rect[2], frame.rect[3]);
+      cv::Point topLeft(frame.rect[0], frame.rect[1]);
+      cv::Point bottomRight(frame.rect[2], frame.rect[3]);
 
-    cv::Scalar color(255, 0, 0);
-    int thickness = 3;
-    // cv::rectangle(mat, topLeft, bottomRight, cv::Scalar(0, 255, 0), 3);
+      cv::Scalar color(255, 0, 0);
+      int thickness = 3;
+      // cv::rectangle(mat, topLeft, bottomRight, cv::Scalar(0, 255, 0), 3);
 
-    char buffer[50] = {0};
-    snprintf(buffer, sizeof(buffer), "out/%03d.png", i);
+      char buffer[50] = {0};
+      snprintf(buffer, sizeof(buffer), "out/%03d.png", i);
 
-    if (cv::imwrite(buffer, mat) == false) {
-      PLOGI << "Error saving image.";
-    } else {
-      PLOGI << "saving image " << buffer;
-    }
+      if (cv::imwrite(buffer, mat) == false) {
+        PLOGI << "Error saving image.";
+      } else {
+        PLOGI << "saving image " << buffer;
+      }
 #endif
-    _videoPack.push(mat, i);
-    double ratio = 4000 * i / wavDuration;
-    json root;
-    root["progress"] = ratio;
-    _queue.push(root.dump() + "\n");
+      _videoPack.push(mat, i);
+      double ratio = 4000 * i / wavDuration;
+      json root;
+      root["progress"] = ratio;
+      _queue.push(root.dump() + "\n");
+    }
   }
 
   json root;
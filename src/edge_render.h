@@ -7,6 +7,8 @@
 #pragma once
 #include "block_queue.h"
 #include "clog.h"
+#include "role_fetch.h"
+#include "role_registry.h"
 #include "video.h"
 #include <atomic>
 #include <digit/GDigit.h>
@@ -17,7 +19,13 @@
 #include <model_info.h>
 #include <string>
 
-typedef std::function<void(std::vector<uint8_t> &data)> ImgHdl;
+// 发送帧: head为4字节长度加metadata, 每帧生成; body为RGBA, 空闲帧在会话间共享
+struct WireFrame {
+  std::vector<uint8_t> head;
+  std::shared_ptr<const std::vector<uint8_t>> body;
+};
+
+typedef std::function<void(const WireFrame &frame)> ImgHdl;
 typedef std::function<void(const std::string &msg)> MsgHdl;
 
 // 线程安全的RGBA帧队列
@@ -79,25 +87,40 @@ public:
   int load(const std::string &role);
   void setImgHdl(ImgHdl handler);
   void setMsgHdl(MsgHdl handler);
-  int checkModel(const std::string &role);
+  // 公共资源和角色不存在时下载, 同一资源并发请求只下载一次, cb接收下载/解压进度
+  // live非空时角色装到可以开始渲染即返回, *live为仍在进行的安装
+  static int checkModel(const std::string &role, const RoleFetcher::ProgressCb &cb = nullptr,
+                        std::shared_ptr<RoleInstall> *live = nullptr);
+  // 后台下载并加载角色, 每个角色做warmup次空推理后常驻内存
+  static void preload(const std::vector<std::string> &roles, int warmup);
+  // 推理服务的批大小/排队时间直方图和arena用量, json字符串, 供/stats接口
+  static std::string stats();
 
   std::string render(const std::string &wav);
   void getMsg(std::string &msg);
   bool done() { return _done.load(); }
 
-  std::map<std::string, std::string> _baseMD5Map;
-  std::map<std::string, std::string> _modelMD5Map;
-
-  ModelInfo _modelInfo;
+  // 角色资源由RoleRegistry共享, 须在_digit之后析构
+  std::shared_ptr<RoleAssets> _assets;
+  const ModelInfo *_modelInfo = nullptr;
+  std::unique_ptr<MReadAhead> _readahead;
   std::unique_ptr<GDigit> _digit;
+  // 工作线程调用_digit, 须在_digit之前析构
+  std::unique_ptr<MRenderAhead> _renderahead;
   VideoPack _videoPack;
   BlockQueue<std::string> _queue;
   std::atomic<bool> _done;
 
   void startRender();
+  void prefetch(int next);
+  // 有pack时帧表以pack为准, 流式安装中的角色帧数会增长
+  size_t frameCount();
+  Frame frameAt(size_t k);
+  // 渲染第index个音频特征对应的说话帧到dst
+  int renderSpeech(int index, const Frame &frame, char *dst);
   SafeQueue<std::future<std::string>> _ttsTasks;
   SafeQueue<std::string> _wavs;
-  SafeQueue<std::shared_ptr<std::vector<uint8_t>>> _frames;
+  SafeQueue<std::shared_ptr<WireFrame>> _frames;
   std::thread _thRender;
   std::thread _thSender;
   std::thread _thWav;
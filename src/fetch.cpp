@@ -1,5 +1,6 @@
 #include "fetch.h"
 #include <curl/curl.h>
+#include <clog.h>
 
 Fetch::Response Fetch::request(const std::string &url,
                                const Fetch::RequestOptions &options) {
@@ -41,6 +42,12 @@ Fetch::Response Fetch::request(const std::string &url,
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
   curl_easy_setopt(curl, CURLOPT_WRITEDATA, &options);
 
+  if (options.onProgress) {
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progressCallback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &options);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+  }
+
   // 头处理回调
   curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerCallback);
   curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response.headers);
@@ -57,7 +64,9 @@ Fetch::Response Fetch::request(const std::string &url,
   }
 
   // 获取状态码
-  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.status_code);
+  long code = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+  response.status_code = static_cast<int>(code);
 
   // 清理
   curl_slist_free_all(headers);
@@ -86,9 +95,15 @@ Fetch::Response Fetch::post(const std::string &url, const std::string &body,
 size_t Fetch::writeCallback(void *contents, size_t size, size_t nmemb,
                             void *userp) {
   size_t realsize = size * nmemb;
-  auto func = static_cast<Fetch::RequestOptions *>(userp)->onData;
-  if (func) {
-    func(static_cast<char *>(contents), realsize);
+  auto &func = static_cast<Fetch::RequestOptions *>(userp)->onData;
+  // 异常不能穿过curl的C代码, 处理出错时返回0让curl中止传输
+  try {
+    if (func && !func(static_cast<char *>(contents), realsize)) {
+      return 0;
+    }
+  } catch (const std::exception &e) {
+    PLOGE << "onData failed: " << e.what();
+    return 0;
   }
 
   // static_cast<std::string *>(userp)->append(static_cast<char *>(contents),
@@ -96,6 +111,12 @@ size_t Fetch::writeCallback(void *contents, size_t size, size_t nmemb,
   return realsize;
 }
 
+int Fetch::progressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
+                            curl_off_t ultotal, curl_off_t ulnow) {
+  auto &func = static_cast<const Fetch::RequestOptions *>(clientp)->onProgress;
+  return func(dlnow, dltotal) ? 0 : 1;
+}
+
 size_t Fetch::headerCallback(char *buffer, size_t size, size_t nitems,
                              void *userdata) {
   size_t realsize = size * nitems;
@@ -26,7 +26,10 @@ public:
     std::string body;
     bool follow_redirects = true;
     long timeout_ms = 0; // 0表示不超时
-    std::function<void(char *, size_t)> onData;
+    // 收到的数据, 返回false中止请求
+    std::function<bool(char *, size_t)> onData;
+    // 下载进度(已收字节, 总字节, 未知为0), 返回false中止请求
+    std::function<bool(int64_t, int64_t)> onProgress;
   };
 
   // 初始化cURL
@@ -53,6 +56,9 @@ private:
   // 响应体写入回调
   static size_t writeCallback(void *contents, size_t size, size_t nmemb,
                               void *userp);
+  // 进度回调
+  static int progressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
+                              curl_off_t ultotal, curl_off_t ulnow);
   // 响应头处理回调
   static size_t headerCallback(char *buffer, size_t size, size_t nitems,
                                void *userdata);
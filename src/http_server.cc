@@ -12,6 +12,8 @@
 #include "util.h"
 #include <edge_render.h>
 #include <getopt.hpp>
+#include <jarena.h>
+#include <munetservice.h>
 #include <memory>
 #include <string>
 #include <cstdlib> // Required for std::getenv
@@ -43,6 +45,14 @@ int main() {
         }
     }
 
+  {
+    std::ifstream stream(conf);
+    if (stream.is_open()) {
+      auto root = json::parse(stream);
+      config->load(root);
+    }
+  }
+
   // This check is now more effective.
   if (config->apiKey.empty()) {
       PLOGE << "Groq API Key is not set. Please set GROQ_API_KEY environment variable or add it to conf.json.";
@@ -53,6 +63,11 @@ int main() {
     PLOGE << "config invalid:" << conf;
     return 0;
   }
+  // arena要在任何会话分配帧和特征缓冲之前建好
+  JArena::get()->init((uint64_t)config->arenaMB << 20, config->arenaHugePages);
+  MunetService::get()->init(config->inferWorkers, config->inferWindowUs, config->inferMaxBatch,
+                            config->inferDeadlineMs);
+  EdgeRender::preload(config->preloadRoles, config->warmupRuns);
 
   std::string IP = getPublicIP();
   PLOGI << "PublicIP:" << IP;
@@ -62,6 +77,10 @@ int main() {
   std::system(cmd.c_str());
   svr.set_mount_point("/video", "./video");
   svr.set_mount_point("/audio", "./audio");
+  svr.Get("/stats", [](const httplib::Request &req, httplib::Response &res) {
+    res.set_header("Access-Control-Allow-Origin", "*");
+    res.set_content(EdgeRender::stats(), "application/json");
+  });
 
   // 处理 OPTIONS 预检请求
   svr.Options("/task_sse",
@@ -37,7 +37,7 @@ void LmClient::request(const std::string &query) {
   options.onData = [&](char *data, size_t len) {
     // buffer += chunk;
     if (done) {
-      return;
+      return true;
     }
     buffer.append(data, len);
 
@@ -84,6 +84,7 @@ void LmClient::request(const std::string &query) {
         arr.push_back("");
         onSubText(arr);
     }
+    return true;
   };
 
   Fetch::request(config->lmUrl + "/chat/completions", options);
@@ -0,0 +1,115 @@
+/*************************************************************************
+    > File Name: mkpack.cc
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月12日 星期三 20时59分11秒
+ ************************************************************************/
+
+#include "aesmain.h"
+#include "clog.h"
+#include "roleface.h"
+#include "rolepack.h"
+#include <filesystem>
+#include <fstream>
+#include <getopt.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+using namespace std;
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+// 确保加密的json已解密, 返回解密后的路径
+static fs::path plainFile(const fs::path &roleDir, const std::string &key,
+                          const std::string &value) {
+  fs::path file = roleDir / value;
+  if (fs::exists(file) == false) {
+    fs::path newFile = roleDir / key;
+    if (!fs::exists(newFile)) {
+      PLOGI << "cant find " << newFile.string();
+      return fs::path();
+    }
+    int ret = mainenc(0, const_cast<char *>(newFile.string().c_str()),
+                      const_cast<char *>(file.string().c_str()));
+    PLOGI << "convert " << newFile.string() << " result:" << ret;
+  }
+  return file;
+}
+
+int main() {
+  std::string role = getarg("siyao", "-r", "--role");
+  std::string dir = getarg("/app/roles", "-d", "--dir");
+  std::string out = getarg("", "-o", "--out");
+  // 同时生成pack旁的frames.gfc, 说话帧不再逐帧裁剪缩放人脸
+  int faces = getarg(1, "-f", "--faces");
+
+  fs::path roleDir = fs::path(dir) / role;
+  if (out.empty()) {
+    out = (roleDir / "frames.gpk").string();
+  }
+
+  fs::path bboxFile = plainFile(roleDir, "bbox.j", "bj");
+  fs::path configFile = plainFile(roleDir, "config.j", "cj");
+  if (bboxFile.empty() || configFile.empty()) {
+    return -1;
+  }
+  std::ifstream bbox(bboxFile);
+  json boxJson = json::parse(bbox);
+  std::ifstream config(configFile);
+  json configJson = json::parse(config);
+
+  int width = configJson.value("width", 0);
+  int height = configJson.value("height", 0);
+  int hasMask = fs::exists(roleDir / "raw_sg") && fs::exists(roleDir / "pha");
+
+  RolePackWriter writer;
+  int ret = writer.begin(out.c_str(), width, height, hasMask);
+  if (ret != 0) {
+    PLOGE << "create pack failed:" << out << " ret:" << ret;
+    return -2;
+  }
+  for (int i = 1;; ++i) {
+    auto rawPath = roleDir / "raw_jpgs" / (std::to_string(i) + ".sij");
+    auto maskPath = roleDir / "pha" / (std::to_string(i) + ".sij");
+    auto sgPath = roleDir / "raw_sg" / (std::to_string(i) + ".sij");
+    if (fs::exists(rawPath) == false) {
+      break;
+    }
+    int rect[4] = {0, 0, 0, 0};
+    if (boxJson.count(std::to_string(i))) {
+      rect[0] = boxJson[std::to_string(i)][0];
+      rect[1] = boxJson[std::to_string(i)][2];
+      rect[2] = boxJson[std::to_string(i)][1];
+      rect[3] = boxJson[std::to_string(i)][3];
+    }
+    std::string msk = hasMask && fs::exists(maskPath) ? maskPath.string() : "";
+    std::string sg = hasMask && fs::exists(sgPath) ? sgPath.string() : "";
+    ret = writer.addfile(rect, rawPath.string().c_str(), msk.c_str(), sg.c_str());
+    if (ret < 0) {
+      PLOGE << "add frame failed:" << rawPath << " ret:" << ret;
+      writer.finish();
+      fs::remove(out);
+      return -3;
+    }
+  }
+
+  ret = writer.finish();
+  PLOGI << "role:" << role << " pack:" << out << " frames:" << ret
+        << " width:" << width << " height:" << height << " hasMask:" << hasMask;
+  if (ret <= 0) {
+    return -4;
+  }
+  if (faces) {
+    std::string faceFile = fs::path(out).replace_extension(".gfc").string();
+    RolePack pack;
+    ret = pack.open(out.c_str());
+    if (ret == 0) {
+      ret = roleface_compile(&pack, out.c_str(), faceFile.c_str());
+    }
+    PLOGI << "faces:" << faceFile << " frames:" << ret;
+    if (ret < 0) {
+      return -5;
+    }
+  }
+  return 0;
+}
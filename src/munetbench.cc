@@ -0,0 +1,307 @@
+/*************************************************************************
+    > File Name: munetbench.cc
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月22日 星期六 15时12分40秒
+ ************************************************************************/
+
+// munet逐帧推理与批量推理(domodels)的吞吐对比, 以及各ncnn精度模式的耗时和相对fp32的PSNR/SSIM
+// 用法: munetbench -m /app/gj_dh_res/role/xxx -w /app/gj_dh_res/weight_168u.b -n 64
+//       -p fp32,fp16s,fp16,bf16  (fp16s为fp16存储fp32计算, 加+flat为不打包布局)
+//       -k 1000  输入预处理/输出混合的旧路径与融合内核各跑的次数, 0不测
+// 注意: 精度对比的输入是随机人脸和全零音频特征, 不是真实帧, PSNR/SSIM只反映数值偏差,
+//       不能代替在真实角色素材上看画面
+
+#include "aicommon.h"
+#include "clog.h"
+#include "cpu.h"
+#include "face_utils.h"
+#include "gaes_stream.h"
+#include "munet.h"
+#include "blendgram.h"
+#include "munet_kernel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <getopt.hpp>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static double nowMs() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Inputs {
+  std::vector<std::unique_ptr<JMat>> pics;
+  std::vector<std::unique_ptr<JMat>> msks;
+  std::vector<std::unique_ptr<JMat>> feats;
+};
+
+// 随机输入, 推理耗时与内容无关
+static void fill(JMat *mat, std::mt19937 &rng) {
+  uint8_t *data = reinterpret_cast<uint8_t *>(mat->data());
+  for (int i = 0; i < mat->size(); ++i) {
+    data[i] = rng() & 0xff;
+  }
+}
+
+static void makeInputs(Inputs &in, int count) {
+  std::mt19937 rng(1234);
+  for (int i = 0; i < count; ++i) {
+    in.pics.emplace_back(new JMat(160, 160, 3, 0, 1));
+    in.msks.emplace_back(new JMat(160, 160, 3, 0, 1));
+    in.feats.emplace_back(new JMat(MFCC_BNFCHUNK, 20, 1));
+    fill(in.pics.back().get(), rng);
+    fill(in.msks.back().get(), rng);
+  }
+}
+
+// 逐帧推理frames帧, 返回每帧平均耗时
+static double single(Mobunet &munet, Inputs &in, int frames) {
+  double t0 = nowMs();
+  for (int i = 0; i < frames; ++i) {
+    int k = i % in.pics.size();
+    munet.domodel(in.pics[k].get(), in.msks[k].get(), in.feats[k].get());
+  }
+  return (nowMs() - t0) / frames;
+}
+
+// 每batch帧一起推理, 返回每帧平均耗时
+static double batched(Mobunet &munet, Inputs &in, int frames, int batch) {
+  std::vector<JMat *> pics(batch);
+  std::vector<JMat *> msks(batch);
+  std::vector<JMat *> feats(batch);
+  double t0 = nowMs();
+  int done = 0;
+  while (done < frames) {
+    int n = std::min(batch, frames - done);
+    for (int k = 0; k < n; ++k) {
+      int idx = (done + k) % in.pics.size();
+      pics[k] = in.pics[idx].get();
+      msks[k] = in.msks[idx].get();
+      feats[k] = in.feats[idx].get();
+    }
+    munet.domodels(pics.data(), msks.data(), feats.data(), n);
+    done += n;
+  }
+  return (nowMs() - t0) / frames;
+}
+
+// 输入预处理: 旧路径为premunet的两次copyTo加rectangle, 再两次from_pixels/normalize和memcpy;
+// 融合内核只拷真实人脸, 遮挡平面在归一化时一起生成
+static void prebench(Mobunet &munet, int runs) {
+  std::mt19937 rng(1234);
+  JMat org(168, 168, 3, 0, 1);
+  fill(&org, rng);
+  cv::Mat roi(org.cvmat(), cv::Rect(4, 4, 160, 160));
+  cv::Rect box(munet_maskbox[0], munet_maskbox[1], munet_maskbox[2], munet_maskbox[3]);
+  JMat real(160, 160, 3, 0, 1);
+  JMat mask(160, 160, 3, 0, 1);
+  cv::Mat cvreal = real.cvmat();
+  cv::Mat cvmask = mask.cvmat();
+  ncnn::Mat ref;
+  ncnn::Mat fused;
+
+  double t0 = nowMs();
+  for (int i = 0; i < runs; ++i) {
+    roi.copyTo(cvmask);
+    roi.copyTo(cvreal);
+    cv::rectangle(cvmask, box, cv::Scalar(0, 0, 0), -1);
+    munet.input(&real, &mask, ref);
+  }
+  double old = (nowMs() - t0) / runs;
+  t0 = nowMs();
+  for (int i = 0; i < runs; ++i) {
+    roi.copyTo(cvreal);
+    munet.input(&real, nullptr, fused);
+  }
+  double ms = (nowMs() - t0) / runs;
+
+  float diff = 0;
+  for (int c = 0; c < ref.c; ++c) {
+    const float *a = ref.channel(c);
+    const float *b = fused.channel(c);
+    for (int i = 0; i < ref.w * ref.h; ++i) {
+      diff = std::max(diff, std::abs(a[i] - b[i]));
+    }
+  }
+  PLOGI << "input old:" << old * 1000 << "us fused:" << ms * 1000
+        << "us speedup:" << old / ms << " maxdiff:" << diff;
+}
+
+// 输出混合: 旧路径为substract_mean_normalize, to_pixels到临时cvout, 再BlendGramAlpha;
+// 融合内核一次完成反归一化, 转bgr和定点混合
+static void postbench(Mobunet &munet, int runs) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> dist(-1.1f, 1.1f);
+  ncnn::Mat out(160, 160, 3);
+  for (int c = 0; c < out.c; ++c) {
+    float *p = out.channel(c);
+    for (int i = 0; i < out.w * out.h; ++i) {
+      p[i] = dist(rng);
+    }
+  }
+  uint8_t *weight = munet.model()->weights()->udata();
+  JMat face(160, 160, 3, 0, 1);
+  fill(&face, rng);
+  JMat ref(160, 160, 3, 0, 1);
+  JMat fused(160, 160, 3, 0, 1);
+  float outmean[3] = {-1.0f, -1.0f, -1.0f};
+  float outnorm[3] = {127.5f, 127.5f, 127.5f};
+
+  // substract_mean_normalize原地修改, 旧路径每次clone一份输出, 耗时含这次拷贝
+  double t0 = nowMs();
+  for (int i = 0; i < runs; ++i) {
+    memcpy(ref.data(), face.data(), face.size());
+    ncnn::Mat tmp = out.clone();
+    tmp.substract_mean_normalize(outmean, outnorm);
+    cv::Mat cvout(160, 160, CV_8UC3);
+    tmp.to_pixels(cvout.data, ncnn::Mat::PIXEL_RGB2BGR);
+    BlendGramAlpha(cvout.data, weight, ref.udata(), 160, 160);
+  }
+  double old = (nowMs() - t0) / runs;
+  t0 = nowMs();
+  for (int i = 0; i < runs; ++i) {
+    memcpy(fused.data(), face.data(), face.size());
+    munet_output((const float *)out.data, out.cstep, weight, fused.udata(), fused.stride());
+  }
+  double ms = (nowMs() - t0) / runs;
+
+  int diff = 0;
+  for (int i = 0; i < face.size(); ++i) {
+    diff = std::max(diff, std::abs(ref.udata()[i] - fused.udata()[i]));
+  }
+  PLOGI << "output old:" << old * 1000 << "us fused:" << ms * 1000
+        << "us speedup:" << old / ms << " maxdiff:" << diff;
+}
+
+// fp32, fp16s(fp16存储fp32计算), fp16, bf16, 可加+flat
+static bool parseMode(const std::string &mode, NcnnPrec &prec) {
+  std::string name = mode;
+  size_t plus = name.find('+');
+  if (plus != std::string::npos) {
+    if (name.substr(plus + 1) != "flat") {
+      return false;
+    }
+    prec.flat = 1;
+    name = name.substr(0, plus);
+  }
+  if (name == "fp16s") {
+    prec.storage = NCNN_PREC_FP16;
+    prec.arith = NCNN_PREC_FP32;
+    return true;
+  }
+  prec.storage = ncnnprec_parse(name.c_str());
+  // bf16没有计算精度, 按fp32计算
+  prec.arith = prec.storage == NCNN_PREC_BF16 ? NCNN_PREC_FP32 : prec.storage;
+  return prec.storage != NCNN_PREC_DEF;
+}
+
+// 每个模式的逐帧耗时, 以及同一组输入上与fp32输出的PSNR/SSIM
+static void precision(const std::vector<char> &bin, const std::vector<char> &param,
+                      const std::vector<char> &msk, int frames, const std::string &modes) {
+  PLOGI << "cpu f16c:" << ncnn::cpu_support_x86_f16c()
+        << " avx512_bf16:" << ncnn::cpu_support_x86_avx512_bf16()
+        << " avx512_fp16:" << ncnn::cpu_support_x86_avx512_fp16();
+  PLOGI << "precision inputs are synthetic: random faces, zero audio features";
+  NcnnPrec fp32;
+  fp32.storage = NCNN_PREC_FP32;
+  fp32.arith = NCNN_PREC_FP32;
+  Mobunet ref(std::make_shared<MunetModel>(bin, param, msk, fp32));
+  Inputs refs;
+  makeInputs(refs, 8);
+  for (size_t k = 0; k < refs.pics.size(); ++k) {
+    ref.domodel(refs.pics[k].get(), refs.msks[k].get(), refs.feats[k].get());
+  }
+
+  std::stringstream ss(modes);
+  for (std::string mode; std::getline(ss, mode, ',');) {
+    NcnnPrec prec;
+    if (!parseMode(mode, prec)) {
+      PLOGE << "unknown mode:" << mode;
+      continue;
+    }
+    Mobunet munet(std::make_shared<MunetModel>(bin, param, msk, prec));
+    if (!munet.model()->ready()) {
+      PLOGE << mode << " init failed";
+      continue;
+    }
+    // makeInputs同一种子, 与参考输出的输入相同
+    Inputs in;
+    makeInputs(in, 8);
+    double psnr = 0, ssim = 0;
+    double minPsnr = 1e9, minSsim = 1e9;
+    for (size_t k = 0; k < in.pics.size(); ++k) {
+      munet.domodel(in.pics[k].get(), in.msks[k].get(), in.feats[k].get());
+      double p = cv::PSNR(refs.pics[k]->cvmat(), in.pics[k]->cvmat());
+      double q = diffssim(refs.pics[k]->cvmat(), in.pics[k]->cvmat());
+      psnr += p;
+      ssim += q;
+      minPsnr = std::min(minPsnr, p);
+      minSsim = std::min(minSsim, q);
+    }
+    double ms = single(munet, in, frames);
+    PLOGI << mode << ": " << ms << "ms/frame PSNR mean:" << psnr / in.pics.size()
+          << "dB min:" << minPsnr << "dB SSIM mean:" << ssim / in.pics.size()
+          << " min:" << minSsim;
+  }
+}
+
+int main() {
+  std::string dir = getarg("/app/gj_dh_res/role/default", "-m", "--model");
+  std::string weight = getarg("/app/gj_dh_res/weight_168u.b", "-w", "--weight");
+  int frames = getarg(64, "-n", "--frames");
+  std::string modes = getarg("fp32,fp16s,fp16,bf16", "-p", "--precision");
+  int kernelRuns = getarg(1000, "-k", "--kernel");
+
+  std::vector<char> bin;
+  std::vector<char> param;
+  std::vector<char> msk;
+  if (gaes_decrypt((fs::path(dir) / "dh_model.b").string(), bin) != 0 ||
+      gaes_decrypt((fs::path(dir) / "dh_model.p").string(), param) != 0) {
+    PLOGE << "decrypt model failed:" << dir;
+    return -1;
+  }
+  std::string own = (fs::path(dir) / "weight_168u.b").string();
+  if (gaes_decrypt(fs::exists(own) ? own : weight, msk) != 0) {
+    PLOGE << "decrypt weight failed:" << weight;
+    return -1;
+  }
+  auto model = std::make_shared<MunetModel>(bin, param, msk);
+  if (!model->ready()) {
+    PLOGE << "munet init failed:" << dir;
+    return -1;
+  }
+  Mobunet munet(model);
+  if (kernelRuns > 0) {
+    prebench(munet, kernelRuns);
+    postbench(munet, kernelRuns);
+  }
+
+  Inputs in;
+  makeInputs(in, 8);
+  // 预热, 排除首次推理的内存分配
+  single(munet, in, 4);
+
+  double base = single(munet, in, frames);
+  PLOGI << "per frame: " << base << "ms/frame";
+  for (int batch : {1, 2, 4, 8}) {
+    double ms = batched(munet, in, frames, batch);
+    PLOGI << "batch " << batch << ": " << ms << "ms/frame speedup:" << base / ms;
+  }
+
+  if (!modes.empty()) {
+    precision(bin, param, msk, frames, modes);
+  }
+  return 0;
+}
@@ -0,0 +1,405 @@
+/*************************************************************************
+    > File Name: munetquant.cc
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月23日 星期日 10时05分18秒
+ ************************************************************************/
+
+// munet int8量化:
+// 1. 用角色素材渲染真实wav, 采集munet实际输入, 分为校准集和留出集
+// 2. 校准集存为npy, 调用ncnn的ncnn2table(需支持npy输入)和ncnn2int8生成int8模型
+// 3. 留出集上逐帧对比fp32和int8输出的PSNR/SSIM及耗时, 写report.csv
+// -i 1 把int8模型加密装到角色目录(dh_model_int8.b/.p), conf.json中munetInt8为true时加载
+// 解密出的fp32模型和生成的int8明文模型只在运行期间存在, 结束时删除
+// 用法: munetquant -r siyao -w a.wav,b.wav -n 200 -t 50 -o /tmp/munet_quant
+
+#include "aesmain.h"
+#include "clog.h"
+#include "face_utils.h"
+#include "gaes_stream.h"
+#include "munet.h"
+#include <algorithm>
+#include <chrono>
+#include <edge_render.h>
+#include <filesystem>
+#include <fstream>
+#include <getopt.hpp>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static double nowMs() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// 一次munet推理的输入副本
+struct Sample {
+  std::unique_ptr<JMat> pic;
+  std::unique_ptr<JMat> msk;
+  std::unique_ptr<JMat> feat;
+};
+
+static JMat *copyMat(JMat *src, int w, int h, int c, int bit) {
+  JMat *dst = new JMat(w, h, c, 0, bit);
+  memcpy(dst->data(), src->data(), std::min(dst->size(), src->size()));
+  return dst;
+}
+
+// 明文(md5名)优先, 否则解密
+static int readModel(const fs::path &dir, const std::string &name, const std::string &plain,
+                     std::vector<char> &buf) {
+  fs::path file = dir / plain;
+  if (fs::exists(file)) {
+    std::ifstream in(file, std::ios::binary);
+    buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return buf.empty() ? -3 : 0;
+  }
+  file = dir / name;
+  if (!fs::exists(file)) {
+    return -1;
+  }
+  return gaes_decrypt(file.string(), buf);
+}
+
+static int readFile(const fs::path &file, std::vector<char> &buf) {
+  std::ifstream in(file, std::ios::binary);
+  if (!in) {
+    return -1;
+  }
+  buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return buf.empty() ? -3 : 0;
+}
+
+static int writeFile(const fs::path &file, const std::vector<char> &buf) {
+  std::ofstream out(file, std::ios::binary);
+  out.write(buf.data(), buf.size());
+  return out.good() ? 0 : -1;
+}
+
+// float32 C序npy, ncnn2table按shape建输入Mat
+static int writeNpy(const fs::path &file, const std::vector<int> &shape,
+                    const std::vector<const float *> &planes, size_t planeSize) {
+  std::string dims;
+  for (size_t k = 0; k < shape.size(); ++k) {
+    dims += std::to_string(shape[k]) + (shape.size() == 1 || k + 1 < shape.size() ? "," : "");
+  }
+  std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (" + dims + "), }";
+  size_t total = 10 + header.size() + 1;
+  header.append((64 - total % 64) % 64, ' ');
+  header += '\n';
+  std::ofstream out(file, std::ios::binary);
+  out.write("\x93NUMPY\x01\x00", 8);
+  uint16_t len = header.size();
+  out.write(reinterpret_cast<const char *>(&len), 2);
+  out.write(header.data(), header.size());
+  for (auto plane : planes) {
+    out.write(reinterpret_cast<const char *>(plane), planeSize * sizeof(float));
+  }
+  return out.good() ? 0 : -1;
+}
+
+// 渲染wav, 每stride次推理取一次输入, 每5个中1个进留出集
+static void collect(const std::string &role, const std::vector<std::string> &wavs, int stride,
+                    size_t calibs, size_t holds, std::vector<Sample> &calib,
+                    std::vector<Sample> &held) {
+  std::mutex lock;
+  int seen = 0;
+  Mobunet::settap([&](JMat *pic, JMat *msk, JMat *feat) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (seen++ % stride) {
+      return;
+    }
+    bool hold = (seen / stride) % 5 == 4;
+    std::vector<Sample> &set = hold ? held : calib;
+    if (set.size() >= (hold ? holds : calibs)) {
+      return;
+    }
+    Sample s;
+    s.pic.reset(copyMat(pic, 160, 160, 3, 1));
+    // 标准嘴部遮挡时msk为空, 由Mobunet::input生成
+    if (msk) {
+      s.msk.reset(copyMat(msk, 160, 160, 3, 1));
+    }
+    s.feat.reset(copyMat(feat, MFCC_BNFCHUNK, 20, 1, 0));
+    set.push_back(std::move(s));
+  });
+  for (const auto &wav : wavs) {
+    auto render = std::make_shared<EdgeRender>();
+    if (render->load(role) != 0) {
+      PLOGE << "load role failed:" << role;
+      break;
+    }
+    std::thread th(&EdgeRender::render, render.get(), wav);
+    std::string data;
+    while (render->done() == false) {
+      render->getMsg(data);
+    }
+    th.join();
+    std::lock_guard<std::mutex> guard(lock);
+    PLOGI << "collected " << wav << " calib:" << calib.size() << " held:" << held.size();
+    if (calib.size() >= calibs && held.size() >= holds) {
+      break;
+    }
+  }
+  Mobunet::settap(nullptr);
+}
+
+// 校准集写成ncnn2table的npy列表: face.txt和audio.txt逐行对应
+static int dumpCalib(Mobunet &munet, std::vector<Sample> &calib, const fs::path &dir) {
+  fs::create_directories(dir / "calib");
+  std::ofstream faces(dir / "face.txt");
+  std::ofstream audios(dir / "audio.txt");
+  for (size_t i = 0; i < calib.size(); ++i) {
+    ncnn::Mat face;
+    munet.input(calib[i].pic.get(), calib[i].msk.get(), face);
+    std::vector<const float *> planes;
+    for (int c = 0; c < face.c; ++c) {
+      planes.push_back(face.channel(c));
+    }
+    fs::path ff = dir / "calib" / ("face_" + std::to_string(i) + ".npy");
+    fs::path fa = dir / "calib" / ("audio_" + std::to_string(i) + ".npy");
+    if (writeNpy(ff, {face.c, face.h, face.w}, planes, face.w * face.h) != 0 ||
+        writeNpy(fa, {1, 20, MFCC_BNFCHUNK}, {calib[i].feat->fdata()}, 20 * MFCC_BNFCHUNK) !=
+            0) {
+      return -1;
+    }
+    faces << fs::absolute(ff).string() << "\n";
+    audios << fs::absolute(fa).string() << "\n";
+  }
+  return 0;
+}
+
+// 明文模型只在运行期间留在输出目录, 任何路径退出都删掉
+struct PlainFiles {
+  std::vector<fs::path> files;
+  ~PlainFiles() {
+    std::error_code ec;
+    for (const auto &file : files) {
+      fs::remove(file, ec);
+    }
+  }
+};
+
+// 加密到临时文件再改名, 角色目录里不会出现写了一半的模型
+static int encryptTo(const fs::path &plain, const fs::path &file) {
+  std::string src = plain.string();
+  std::string tmp = file.string() + ".tmp";
+  int ret = mainenc(1, (char *)src.c_str(), (char *)tmp.c_str());
+  std::error_code ec;
+  if (ret == 0) {
+    fs::rename(tmp, file, ec);
+  }
+  if (ret != 0 || ec) {
+    fs::remove(tmp, ec);
+    return ret != 0 ? ret : -1;
+  }
+  return 0;
+}
+
+// 参数逐个传给execvp, 不经过shell, 路径里的空格和特殊字符原样传递; 返回工具的退出码
+static int runTool(const std::vector<std::string> &args) {
+  std::string cmd;
+  std::vector<char *> argv;
+  for (const auto &arg : args) {
+    cmd += (cmd.empty() ? "" : " ") + arg;
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  PLOGI << "run: " << cmd;
+  pid_t pid = fork();
+  if (pid < 0) {
+    PLOGE << "fork failed: " << strerror(errno);
+    return -1;
+  }
+  if (pid == 0) {
+    execvp(argv[0], argv.data());
+    fprintf(stderr, "exec %s failed: %s\n", argv[0], strerror(errno));
+    _exit(127);
+  }
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      PLOGE << "wait failed: " << strerror(errno);
+      return -1;
+    }
+  }
+  if (WIFSIGNALED(status)) {
+    PLOGE << "killed by signal " << WTERMSIG(status) << ": " << cmd;
+    return -1;
+  }
+  int ret = WEXITSTATUS(status);
+  if (ret != 0) {
+    PLOGE << "exit status " << ret << ": " << cmd;
+  }
+  return ret;
+}
+
+// 留出集上逐帧对比, 每个模型各推理一遍同一份输入副本
+static void report(Mobunet &fp32, Mobunet &int8, std::vector<Sample> &held,
+                   const fs::path &file) {
+  std::ofstream csv(file);
+  csv << "frame,psnr,ssim,fp32_ms,int8_ms\n";
+  std::vector<double> psnrs;
+  std::vector<double> ssims;
+  double sum32 = 0, sum8 = 0;
+  for (size_t i = 0; i < held.size(); ++i) {
+    Sample &s = held[i];
+    std::unique_ptr<JMat> a(copyMat(s.pic.get(), 160, 160, 3, 1));
+    std::unique_ptr<JMat> b(copyMat(s.pic.get(), 160, 160, 3, 1));
+    double t0 = nowMs();
+    fp32.domodel(a.get(), s.msk.get(), s.feat.get());
+    double t1 = nowMs();
+    int8.domodel(b.get(), s.msk.get(), s.feat.get());
+    double t2 = nowMs();
+    cv::Mat ma = a->cvmat();
+    cv::Mat mb = b->cvmat();
+    double p = cv::PSNR(ma, mb);
+    double q = diffssim(ma, mb);
+    psnrs.push_back(p);
+    ssims.push_back(q);
+    // 首帧含内存分配, 不计入平均耗时
+    if (i) {
+      sum32 += t1 - t0;
+      sum8 += t2 - t1;
+    }
+    csv << i << "," << p << "," << q << "," << t1 - t0 << "," << t2 - t1 << "\n";
+  }
+  if (held.size() < 2) {
+    PLOGE << "held-out set too small: " << held.size();
+    return;
+  }
+  auto mean = [](const std::vector<double> &v) {
+    double sum = 0;
+    for (double x : v) {
+      sum += x;
+    }
+    return sum / v.size();
+  };
+  std::vector<double> sorted = psnrs;
+  std::sort(sorted.begin(), sorted.end());
+  int runs = held.size() - 1;
+  PLOGI << "held-out frames:" << held.size();
+  PLOGI << "PSNR mean:" << mean(psnrs) << "dB min:" << sorted.front()
+        << "dB p5:" << sorted[sorted.size() / 20];
+  PLOGI << "SSIM mean:" << mean(ssims)
+        << " min:" << *std::min_element(ssims.begin(), ssims.end());
+  PLOGI << "fp32:" << sum32 / runs << "ms/frame int8:" << sum8 / runs
+        << "ms/frame speedup:" << sum32 / sum8;
+  PLOGI << "per frame report: " << file.string();
+}
+
+int main() {
+  std::string role = getarg("siyao", "-r", "--role");
+  std::string roles = getarg("/app/roles", "-d", "--dir");
+  std::string base = getarg("/app/gj_dh_res", "-b", "--base");
+  std::string wavlist = getarg("", "-w", "--wav");
+  int calibs = getarg(200, "-n", "--calib");
+  int holds = getarg(50, "-t", "--test");
+  int stride = getarg(3, "-s", "--stride");
+  std::string out = getarg("/tmp/munet_quant", "-o", "--out");
+  std::string table = getarg("ncnn2table", "--table", "--table");
+  std::string toint8 = getarg("ncnn2int8", "--int8", "--int8");
+  int install = getarg(0, "-i", "--install");
+
+  std::vector<std::string> wavs;
+  std::stringstream ss(wavlist);
+  for (std::string wav; std::getline(ss, wav, ',');) {
+    if (!wav.empty()) {
+      wavs.push_back(wav);
+    }
+  }
+  if (wavs.empty()) {
+    PLOGE << "no wav, use -w a.wav,b.wav";
+    return -1;
+  }
+  fs::path roleDir = fs::path(roles) / role;
+  fs::path outDir(out);
+  fs::create_directories(outDir);
+
+  std::vector<Sample> calib;
+  std::vector<Sample> held;
+  collect(role, wavs, std::max(1, stride), calibs, holds, calib, held);
+  if (calib.empty() || held.empty()) {
+    PLOGE << "not enough frames, calib:" << calib.size() << " held:" << held.size();
+    return -1;
+  }
+
+  std::vector<char> bin, param, msk;
+  if (readModel(roleDir, "dh_model.b", "db", bin) != 0 ||
+      readModel(roleDir, "dh_model.p", "dp", param) != 0) {
+    PLOGE << "read model failed:" << roleDir.string();
+    return -1;
+  }
+  if (readModel(roleDir, "weight_168u.b", "wb", msk) != 0 &&
+      readModel(base, "weight_168u.b", "wb", msk) != 0) {
+    PLOGE << "read weight failed:" << base;
+    return -1;
+  }
+  fs::path fparam = outDir / "dh_model.param";
+  fs::path fbin = outDir / "dh_model.bin";
+  fs::path qparam = outDir / "dh_model_int8.param";
+  fs::path qbin = outDir / "dh_model_int8.bin";
+  fs::path ftable = outDir / "munet.table";
+  PlainFiles plains{{fparam, fbin, qparam, qbin}};
+  if (writeFile(fparam, param) != 0 || writeFile(fbin, bin) != 0) {
+    PLOGE << "write fp32 model failed:" << outDir.string();
+    return -1;
+  }
+  Mobunet fp32(std::make_shared<MunetModel>(bin, param, msk));
+  if (!fp32.model()->ready()) {
+    PLOGE << "fp32 model init failed";
+    return -1;
+  }
+
+  if (dumpCalib(fp32, calib, outDir) != 0) {
+    PLOGE << "write calibration set failed:" << outDir.string();
+    return -1;
+  }
+  std::string lists = (outDir / "face.txt").string() + "," + (outDir / "audio.txt").string();
+  std::string shape = "shape=[160,160,6],[" + std::to_string(MFCC_BNFCHUNK) + ",20,1]";
+  if (runTool({table, fparam.string(), fbin.string(), lists, ftable.string(), shape, "type=1",
+               "method=kl"}) != 0 ||
+      runTool({toint8, fparam.string(), fbin.string(), qparam.string(), qbin.string(),
+               ftable.string()}) != 0) {
+    PLOGE << "calibration set kept in " << outDir.string();
+    return -1;
+  }
+
+  std::vector<char> qb, qp;
+  if (readFile(qbin, qb) != 0 || readFile(qparam, qp) != 0) {
+    PLOGE << "read int8 model failed:" << outDir.string();
+    return -1;
+  }
+  Mobunet int8(std::make_shared<MunetModel>(qb, qp, msk));
+  if (!int8.model()->ready()) {
+    PLOGE << "int8 model init failed";
+    return -1;
+  }
+  report(fp32, int8, held, outDir / "report.csv");
+
+  if (install) {
+    // 与角色的其他模型一样加密存放; 旧版本装的明文qb/qp会被RoleRegistry优先读取, 一并删除
+    if (encryptTo(qbin, roleDir / "dh_model_int8.b") != 0 ||
+        encryptTo(qparam, roleDir / "dh_model_int8.p") != 0) {
+      PLOGE << "install int8 model failed:" << roleDir.string();
+      return -1;
+    }
+    std::error_code ec;
+    fs::remove(roleDir / "qb", ec);
+    fs::remove(roleDir / "qp", ec);
+    PLOGI << "installed int8 model to " << roleDir.string();
+  }
+  return 0;
+}
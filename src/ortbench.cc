@@ -0,0 +1,86 @@
+/*************************************************************************
+    > File Name: ortbench.cc
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月15日 星期六 10时26分02秒
+ ************************************************************************/
+
+// wenet启动耗时对比: 默认选项, 首次写优化缓存, 从优化缓存加载
+// 用法: ortbench -m /app/gj_dh_res/wenet.o -n 3 -d /tmp/ort_bench
+
+#include "aicommon.h"
+#include "clog.h"
+#include "gaes_stream.h"
+#include "role_registry.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <getopt.hpp>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static double nowMs() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// 创建一次Wenet并跑一次推理, 返回创建和首次推理耗时
+static void once(const std::vector<char> &model, const AiOpts &opts, double &init,
+                 double &first) {
+  std::vector<float> mel(MFCC_MELBASE * MFCC_MELCHUNK);
+  std::vector<float> bnf(MFCC_BNFBASE * MFCC_BNFCHUNK);
+  double t0 = nowMs();
+  Wenet net(model.data(), model.size(), opts);
+  double t1 = nowMs();
+  net.calcbnf(mel.data(), MFCC_MELBASE, bnf.data(), MFCC_BNFBASE);
+  init = t1 - t0;
+  first = nowMs() - t1;
+}
+
+static void report(const std::string &name, const std::vector<char> &model,
+                   const AiOpts &opts, int runs, bool fresh) {
+  double init = 0, first = 0;
+  double sumInit = 0, sumFirst = 0;
+  for (int i = 0; i < runs; ++i) {
+    if (fresh && !opts.cachedir.empty()) {
+      fs::remove_all(opts.cachedir);
+    }
+    once(model, opts, init, first);
+    sumInit += init;
+    sumFirst += first;
+  }
+  PLOGI << name << " init:" << sumInit / runs << "ms first run:" << sumFirst / runs << "ms";
+}
+
+int main() {
+  std::string model = getarg("/app/gj_dh_res/wenet.o", "-m", "--model");
+  int runs = getarg(3, "-n", "--runs");
+  std::string dir = getarg("/tmp/ort_bench", "-d", "--dir");
+
+  std::vector<char> buf;
+  if (fs::path(model).extension() == ".onnx") {
+    std::ifstream in(model, std::ios::binary);
+    buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  } else if (gaes_decrypt(model, buf) != 0) {
+    PLOGE << "decrypt failed:" << model;
+    return -1;
+  }
+  if (buf.empty()) {
+    PLOGE << "empty model:" << model;
+    return -1;
+  }
+
+  AiOpts opts = ortOptions();
+  opts.cachedir.clear();
+  report("no cache", buf, opts, runs, false);
+
+  opts.cachedir = dir;
+  report("cache write", buf, opts, runs, true);
+  report("cache hit", buf, opts, runs, false);
+  fs::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,182 @@
+/*************************************************************************
+    > File Name: role_fetch.cpp
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月14日 星期五 21时12分40秒
+ ************************************************************************/
+
+#include "role_fetch.h"
+#include "config.h"
+#include "fetch.h"
+#include <clog.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+RoleFetcher *RoleFetcher::get() {
+  static RoleFetcher fetcher;
+  return &fetcher;
+}
+
+std::string RoleFetcher::mirror(const std::string &url) {
+  auto conf = config::get();
+  if (conf->cdnUrl.empty()) {
+    return url;
+  }
+  std::string base = conf->cdnUrl;
+  if (base.back() != '/') {
+    base += '/';
+  }
+  return base + fs::path(url).filename().string();
+}
+
+int RoleFetcher::ensure(const std::string &key, const std::string &url, const std::string &dir,
+                        const std::string &inner, const ProgressCb &cb,
+                        std::shared_ptr<RoleInstall> *live) {
+  if (fs::exists(dir)) {
+    return 0;
+  }
+
+  std::shared_ptr<Flight> flight;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // 加锁后再查一次, 上一次下载可能刚刚完成
+    if (fs::exists(dir)) {
+      return 0;
+    }
+    auto it = _flights.find(key);
+    if (it == _flights.end()) {
+      flight = std::make_shared<Flight>();
+      _flights[key] = flight;
+      // 下载在后台线程进行, 提前返回的会话不会中断它
+      std::thread([this, key, flight, url, dir, inner]() {
+        int ret = fetch(*flight, url, dir, inner);
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _flights.erase(key);
+        }
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        flight->ret = ret;
+        flight->done = true;
+        flight->watchers.clear();
+        flight->cond.notify_all();
+      }).detach();
+    } else {
+      flight = it->second;
+      PLOGI << "wait for " << key << " fetched by another session";
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(flight->mutex);
+  int id = -1;
+  if (cb) {
+    id = flight->nextWatcher++;
+    flight->watchers[id] = cb;
+    cb(flight->stage, flight->percent);
+  }
+  flight->cond.wait(lock, [&flight, live] { return flight->done || (live && flight->install); });
+  // 回调在flight->mutex下调用, 移除后不会再被调到
+  flight->watchers.erase(id);
+  if (flight->done) {
+    return flight->ret;
+  }
+  *live = flight->install;
+  return 0;
+}
+
+void RoleFetcher::notify(Flight &flight, const std::string &stage, int percent) {
+  std::lock_guard<std::mutex> lock(flight.mutex);
+  if (flight.stage == stage && flight.percent == percent) {
+    return;
+  }
+  flight.stage = stage;
+  flight.percent = percent;
+  for (auto &w : flight.watchers) {
+    w.second(stage, percent);
+  }
+}
+
+int RoleFetcher::fetch(Flight &flight, const std::string &url, const std::string &dir,
+                       const std::string &inner) {
+  fs::path target(dir);
+  fs::path staging = target.string() + ".extract";
+  std::error_code ec;
+  fs::remove_all(staging, ec);
+  fs::create_directories(staging, ec);
+  if (ec) {
+    PLOGE << "create " << staging << " failed: " << ec.message();
+    return -1;
+  }
+
+  // 边下载边解出, 帧直接写进frames.gpk, 不落地zip
+  PLOGI << "download " << url << " -> " << target;
+  auto install = std::make_shared<RoleInstall>(staging.string(), inner,
+                                               config::get()->installWindow);
+  int error = 0;
+  // 是否已开放给会话, 只在下载线程读写; flight.install由flight.mutex保护
+  bool shared = false;
+  // 开放后失败: 等正在从staging加载的会话读完再删, 标记失败让之后的会话重新加载;
+  // 已打开的pack是映射, 目录删除后已开放的帧仍可读
+  auto discard = [&]() {
+    std::error_code ec;
+    if (!shared) {
+      fs::remove_all(staging, ec);
+      return;
+    }
+    auto lock = install->move();
+    install->fail();
+    fs::remove_all(staging, ec);
+  };
+  Fetch::RequestOptions options;
+  options.onData = [&](char *data, size_t size) {
+    if (error == 0) {
+      try {
+        error = install->feed(data, size);
+      } catch (const std::exception &e) {
+        PLOGE << "install " << dir << " failed: " << e.what();
+        error = -1;
+      }
+    }
+    if (error == 0 && !shared && install->ready()) {
+      shared = true;
+      std::lock_guard<std::mutex> lock(flight.mutex);
+      flight.install = install;
+      flight.cond.notify_all();
+    }
+    return error == 0;
+  };
+  options.onProgress = [this, &flight, &error](int64_t now, int64_t total) {
+    notify(flight, "download", total > 0 ? static_cast<int>(now * 100 / total) : -1);
+    return error == 0;
+  };
+  auto res = Fetch::request(url, options);
+  if (!res.ok() || error != 0) {
+    PLOGE << "download failed: " << url << " status:" << res.status_code << " error:" << error;
+    discard();
+    return -2;
+  }
+
+  notify(flight, "extract", 0);
+  int ret = install->finish();
+  if (ret != 0) {
+    discard();
+    return -3;
+  }
+  {
+    // 正在从staging加载的会话先读完
+    auto lock = install->move();
+    fs::rename(staging, target, ec);
+    if (ec) {
+      PLOGE << "rename " << staging << " failed: " << ec.message();
+      install->fail();
+      return -4;
+    }
+    install->moved(target.string());
+  }
+  notify(flight, "extract", 100);
+  PLOGI << "fetched " << target;
+  return 0;
+}
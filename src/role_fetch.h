@@ -0,0 +1,54 @@
+/*************************************************************************
+    > File Name: role_fetch.h
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月14日 星期五 21时12分40秒
+ ************************************************************************/
+#pragma once
+#include "role_install.h"
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 资源按key单飞下载: 同一key同时只有一个后台线程边下载边安装, 其余请求等待其结果;
+// 目录已存在的资源不加锁直接返回, 不同key互不阻塞
+class RoleFetcher {
+public:
+  // stage为"download"或"extract", percent为0-100, 下载总大小未知时为-1
+  typedef std::function<void(const std::string &stage, int percent)> ProgressCb;
+
+  static RoleFetcher *get();
+  // 确保url指向的zip已解压到dir; zip内的顶层目录名为inner.
+  // live非空时安装到可以开始渲染就返回, *live为正在进行的安装, 已装完则为空
+  int ensure(const std::string &key, const std::string &url, const std::string &dir,
+             const std::string &inner, const ProgressCb &cb = nullptr,
+             std::shared_ptr<RoleInstall> *live = nullptr);
+  // 配置了cdnUrl时把下载地址换成cdnUrl下的同名文件
+  static std::string mirror(const std::string &url);
+
+private:
+  struct Flight {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    int ret = 0;
+    std::string stage = "download";
+    int percent = 0;
+    int nextWatcher = 0;
+    std::map<int, ProgressCb> watchers;
+    // 可以开始渲染后才设置
+    std::shared_ptr<RoleInstall> install;
+  };
+
+  RoleFetcher() {}
+  int fetch(Flight &flight, const std::string &url, const std::string &dir,
+            const std::string &inner);
+  void notify(Flight &flight, const std::string &stage, int percent);
+
+  std::mutex _mutex;
+  std::map<std::string, std::shared_ptr<Flight>> _flights;
+};
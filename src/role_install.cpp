@@ -0,0 +1,263 @@
+/*************************************************************************
+    > File Name: role_install.cpp
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月16日 星期日 15时08分21秒
+ ************************************************************************/
+
+#include "role_install.h"
+#include "gaes_stream.h"
+#include <clog.h>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+// 边写边读的pack先按此大小建稀疏文件, 读端一次映射, 完成后截断到实际大小
+static const uint64_t kLiveCapacity = 64ULL << 30;
+// 会话可用前必须到齐的文件
+static const char *kRequired[] = {"dh_model.b", "dh_model.p", "bbox.j", "config.j"};
+
+// 没有或不是整数的键按0
+static int intValue(const json &root, const char *key) {
+  auto it = root.find(key);
+  return it != root.end() && it->is_number_integer() ? it->get<int>() : 0;
+}
+
+RoleInstall::RoleInstall(const std::string &dir, const std::string &inner, int window)
+    : _dir(dir), _inner(inner), _window(window) {
+  _zip.onBegin = [this](const std::string &name) { return begin(name); };
+  _zip.onData = [this](const char *data, size_t size) { return this->data(data, size); };
+  _zip.onEnd = [this]() { return end(); };
+}
+
+int RoleInstall::feed(const char *data, size_t size) { return _zip.feed(data, size); }
+
+// raw_jpgs/12.sij -> 第11帧的GPK_RAW
+int RoleInstall::plane(const std::string &rel, int &frame, int &kind) {
+  static const std::pair<const char *, int> dirs[] = {
+      {"raw_jpgs/", GPK_RAW}, {"pha/", GPK_MASK}, {"raw_sg/", GPK_FG}};
+  for (const auto &d : dirs) {
+    std::string prefix = d.first;
+    if (rel.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+    std::string stem = rel.substr(prefix.size());
+    if (stem.size() <= 4 || stem.compare(stem.size() - 4, 4, ".sij") != 0) {
+      return -1;
+    }
+    stem.resize(stem.size() - 4);
+    if (stem.find_first_not_of("0123456789") != std::string::npos) {
+      return -1;
+    }
+    // 条目名来自网络, 超出int的帧号当作无效条目
+    errno = 0;
+    long index = std::strtol(stem.c_str(), nullptr, 10);
+    if (errno == ERANGE || index > INT_MAX) {
+      return -1;
+    }
+    frame = (int)index - 1;
+    kind = d.second;
+    return frame >= 0 ? 0 : -1;
+  }
+  return -1;
+}
+
+// zip条目名来自网络, 规整后不能为空, 不能是绝对路径, 也不能含.., 否则会写到解出目录之外
+static bool safeRel(const std::string &name, std::string &rel) {
+  fs::path path = fs::path(name).lexically_normal();
+  if (path.empty() || path == "." || path.has_root_path()) {
+    return false;
+  }
+  for (const auto &part : path) {
+    if (part == "..") {
+      return false;
+    }
+  }
+  rel = path.generic_string();
+  return true;
+}
+
+int RoleInstall::begin(const std::string &name) {
+  _rel.clear();
+  _frame = -1;
+  _kind = -1;
+  std::string prefix = _inner + "/";
+  if (name.compare(0, prefix.size(), prefix) != 0 || name.size() == prefix.size()) {
+    return 0; // 顶层目录之外的条目不要
+  }
+  if (!safeRel(name.substr(prefix.size()), _rel)) {
+    PLOGE << "unsafe zip entry:" << name;
+    _rel.clear();
+    return -1;
+  }
+  if (_rel.back() == '/') {
+    std::error_code ec;
+    fs::create_directories(fs::path(_dir) / _rel, ec);
+    _rel.clear();
+    return 0;
+  }
+
+  if (plane(_rel, _frame, _kind) == 0) {
+    if (!_pack) {
+      _pack = std::make_unique<RolePackWriter>();
+      std::string packfn = (fs::path(_dir) / "frames.gpk").string();
+      int ret = -1;
+      if (_window > 0) {
+        ret = _pack->beginlive(packfn.c_str(), kLiveCapacity);
+        _live = ret == 0;
+      }
+      if (ret != 0) {
+        PLOGI << "role pack written without live reading, ret:" << ret;
+        ret = _pack->begin(packfn.c_str(), 0, 0, 0);
+      }
+      if (ret != 0) {
+        PLOGE << "create role pack failed:" << packfn << " ret:" << ret;
+        return ret;
+      }
+    }
+    _buf.clear();
+    return 0;
+  }
+
+  fs::path file = fs::path(_dir) / _rel;
+  std::error_code ec;
+  fs::create_directories(file.parent_path(), ec);
+  _file.open(file, std::ios::binary | std::ios::trunc);
+  if (!_file.is_open()) {
+    PLOGE << "open failed: " << file;
+    return -1;
+  }
+  return 0;
+}
+
+int RoleInstall::data(const char *data, size_t size) {
+  if (_frame >= 0) {
+    _buf.insert(_buf.end(), data, data + size);
+  } else if (_file.is_open()) {
+    _file.write(data, size);
+    if (!_file) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int RoleInstall::end() {
+  if (_frame >= 0) {
+    int ret = _pack->put(_frame, _kind, _buf.data(), _buf.size());
+    if (ret < 0) {
+      PLOGE << "write frame " << _rel << " failed:" << ret;
+      return ret;
+    }
+    _sawMask |= _kind == GPK_MASK;
+    _sawFg |= _kind == GPK_FG;
+    applyBox(_frame);
+    publish();
+    return 0;
+  }
+  if (!_file.is_open()) {
+    return 0;
+  }
+  _file.close();
+  if (!_file) {
+    return -1;
+  }
+  _files.insert(_rel);
+
+  // bbox和config决定帧框, 尺寸和是否需要前景图
+  if (_rel == "bbox.j" || _rel == "config.j") {
+    std::vector<char> buf;
+    int ret = gaes_decrypt((fs::path(_dir) / _rel).string(), buf);
+    if (ret != 0) {
+      PLOGE << "decrypt " << _rel << " failed:" << ret;
+      return ret;
+    }
+    // 内容来自网络, 类型不对的json按坏文件处理, 不能让nlohmann抛异常
+    json root = json::parse(buf.begin(), buf.end(), nullptr, false);
+    if (root.is_discarded() || !root.is_object()) {
+      return -2;
+    }
+    if (_rel == "bbox.j") {
+      _boxJson = root;
+      _hasBox = true;
+      for (int k = 0; _pack && k < _pack->count(); ++k) {
+        applyBox(k);
+      }
+    } else {
+      _needPng = intValue(root, "need_png");
+      _width = intValue(root, "width");
+      _height = intValue(root, "height");
+    }
+  }
+  publish();
+  return 0;
+}
+
+void RoleInstall::applyBox(int frame) {
+  std::string key = std::to_string(frame + 1);
+  if (!_hasBox || !_pack || !_boxJson.count(key)) {
+    return;
+  }
+  const auto &box = _boxJson[key];
+  if (!box.is_array() || box.size() < 4) {
+    PLOGE << "bad box of frame " << key;
+    return;
+  }
+  for (int k = 0; k < 4; ++k) {
+    if (!box[k].is_number_integer()) {
+      PLOGE << "bad box of frame " << key;
+      return;
+    }
+  }
+  int rect[4] = {box[0], box[2], box[1], box[3]};
+  _pack->setbox(frame, rect);
+}
+
+// 从已开放的帧往后, 连续的完整帧开放给会话
+void RoleInstall::publish() {
+  if (!_live || !_hasBox || _needPng < 0) {
+    return;
+  }
+  // 需要前景图的角色, 在看到raw_sg之前无法确定是否有掩码, 先不开放
+  _pack->setinfo(_width, _height, _needPng == 0);
+  int n = _pack->published();
+  while (n < _pack->count() && _pack->has(n, GPK_RAW) &&
+         (_needPng != 0 || _pack->has(n, GPK_FG))) {
+    ++n;
+  }
+  _pack->publish(n);
+
+  if (_ready.load() || n < _window) {
+    return;
+  }
+  for (const char *name : kRequired) {
+    if (_files.count(name) == 0) {
+      return;
+    }
+  }
+  PLOGI << "role ready for sessions with " << n << " frames: " << _dir;
+  _ready.store(true);
+}
+
+int RoleInstall::finish() {
+  if (!_zip.finished()) {
+    PLOGE << "zip truncated: " << _dir;
+    return -1;
+  }
+  if (_pack) {
+    _pack->setinfo(_width, _height, _sawMask && _sawFg);
+    int ret = _pack->finish();
+    if (ret < 0) {
+      PLOGE << "finish role pack failed:" << ret;
+      return ret;
+    }
+    PLOGI << "role pack frames:" << ret;
+  }
+  // finished要等改名之后, 在此之前到来的会话仍从staging加载
+  _ready.store(true);
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*************************************************************************
+    > File Name: role_install.h
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月16日 星期日 15时08分21秒
+ ************************************************************************/
+#pragma once
+#include "zip_stream.h"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <rolepack.h>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// 流式安装角色zip: 条目边下载边解出, raw_jpgs/pha/raw_sg下的帧直接写入frames.gpk,
+// 其余文件写入目录. 模型, bbox和config到齐且前window帧完整后ready()为true,
+// 会话即可用正在写入的pack开始渲染, 之后到达的帧随publish加入轮转
+class RoleInstall {
+public:
+  // dir为解出目录, zip内的条目去掉顶层目录inner后写入; window为0时不提前开放
+  RoleInstall(const std::string &dir, const std::string &inner, int window);
+  int feed(const char *data, size_t size);
+  // 下载结束后调用, 写完pack的索引表
+  int finish();
+  bool ready() const { return _ready.load(); }
+  // 已改名到最终目录, 之后按普通角色从该目录加载
+  bool finished() const { return _finished.load(); }
+
+  // 安装完成后目录会被改名, 读目录期间须持有hold()
+  std::shared_lock<std::shared_mutex> hold() { return std::shared_lock<std::shared_mutex>(_dirMutex); }
+  std::unique_lock<std::shared_mutex> move() { return std::unique_lock<std::shared_mutex>(_dirMutex); }
+  std::string dir() const { return _dir; }
+  // 持有move()改名后调用
+  void moved(const std::string &dir) {
+    _dir = dir;
+    _finished.store(true);
+  }
+  // 开放给会话后安装失败, staging已删除; 持有move()时调用
+  void fail() { _failed.store(true); }
+  bool failed() const { return _failed.load(); }
+  // 可边写边读的pack, 没有帧或不能提前开放时为空
+  RolePackWriter *livePack() { return _live ? _pack.get() : nullptr; }
+
+private:
+  int begin(const std::string &name);
+  int data(const char *data, size_t size);
+  int end();
+  int plane(const std::string &rel, int &frame, int &kind);
+  void applyBox(int frame);
+  void publish();
+
+  std::string _dir;
+  std::string _inner;
+  int _window = 0;
+  ZipStream _zip;
+  std::shared_mutex _dirMutex;
+
+  // 当前条目: 帧数据先攒在_buf里整块写入pack, 其余文件直接写出
+  std::string _rel;
+  int _frame = -1;
+  int _kind = -1;
+  std::vector<uint8_t> _buf;
+  std::ofstream _file;
+
+  std::unique_ptr<RolePackWriter> _pack;
+  bool _live = false;
+  std::set<std::string> _files;
+  nlohmann::json _boxJson;
+  bool _hasBox = false;
+  int _needPng = -1;
+  int _width = 0;
+  int _height = 0;
+  bool _sawMask = false;
+  bool _sawFg = false;
+  std::atomic<bool> _ready{false};
+  std::atomic<bool> _finished{false};
+  std::atomic<bool> _failed{false};
+};
@@ -0,0 +1,588 @@
+/*************************************************************************
+    > File Name: role_registry.cpp
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月11日 星期二 22时50分37秒
+ ************************************************************************/
+
+#include "role_registry.h"
+#include "aesmain.h"
+#include "aicommon.h"
+#include "gaes_stream.h"
+#include "config.h"
+#include "util.h"
+#include <clog.h>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <set>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+IdlePayloadCache::Body IdlePayloadCache::get(int frame) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _bodies.find(frame);
+  if (it == _bodies.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+IdlePayloadCache::Body IdlePayloadCache::put(int frame, const Body &body) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _bodies.find(frame);
+  if (it != _bodies.end()) {
+    return it->second;
+  }
+  if (_used + body->size() > _budget) {
+    return body;
+  }
+  _used += body->size();
+  _bodies[frame] = body;
+  return body;
+}
+
+RoleRegistry::RoleRegistry() {
+  _baseMD5Map = {{"cacert.p", "cp"},
+                 {"weight_168u.b", "wb"},
+                 {"wenet.o", "wo"}};
+  _modelMD5Map = {{"dh_model.b", "db"},
+                  {"dh_model.p", "dp"},
+                  {"dh_model_int8.b", "qb"},
+                  {"dh_model_int8.p", "qp"},
+                  {"bbox.j", "bj"},
+                  {"config.j", "cj"},
+                  {"weight_168u.b", "wb"}};
+}
+
+RoleRegistry *RoleRegistry::get() {
+  static RoleRegistry registry;
+  return &registry;
+}
+
+size_t RoleRegistry::size() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  size_t n = 0;
+  for (const auto &p : _roles) {
+    if (p.second.expired() == false) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+// 从失败的安装加载的资源不再给新会话, 已在用的会话保留到结束
+static std::shared_ptr<RoleAssets> usable(const std::weak_ptr<RoleAssets> &cached) {
+  auto assets = cached.lock();
+  if (assets && assets->install && assets->install->failed()) {
+    return nullptr;
+  }
+  return assets;
+}
+
+int RoleRegistry::acquire(const std::string &role, std::shared_ptr<RoleAssets> &assets,
+                          const std::shared_ptr<RoleInstall> &live) {
+  std::shared_ptr<std::mutex> loading;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    assets = usable(_roles[role]);
+    if (assets) {
+      return 0;
+    }
+    auto &mx = _loading[role];
+    if (!mx) {
+      mx = std::make_shared<std::mutex>();
+    }
+    loading = mx;
+  }
+
+  // 同一角色只加载一次, 其他会话等待加载结果
+  std::lock_guard<std::mutex> guard(*loading);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    assets = usable(_roles[role]);
+    if (assets) {
+      return 0;
+    }
+  }
+
+  auto loaded = std::make_shared<RoleAssets>();
+  loaded->role = role;
+  int ret = load(*loaded, live);
+  if (ret != 0) {
+    PLOGE << "load role assets failed:" << role << " ret:" << ret;
+    return ret;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _roles[role] = loaded;
+  assets = loaded;
+  return 0;
+}
+
+// 用与会话相同的输入尺寸各跑一次, 空数据即可; msk为空与会话一样走融合的munet_input
+static void warmup(RoleAssets &assets, int runs) {
+  Mobunet munet(assets.munet);
+  JMat pic(160, 160, 3, 0, 1);
+  JMat feat(MFCC_BNFCHUNK, 20, 1);
+  std::vector<float> mel(MFCC_MELBASE * MFCC_MELCHUNK);
+  std::vector<float> bnf(MFCC_BNFBASE * MFCC_BNFCHUNK);
+  for (int i = 0; i < runs; ++i) {
+    munet.domodel(&pic, nullptr, &feat);
+    assets.wenet->calcbnf(mel.data(), MFCC_MELBASE, bnf.data(), MFCC_BNFBASE);
+  }
+}
+
+int RoleRegistry::preload(const std::string &role, int runs) {
+  std::shared_ptr<RoleAssets> assets;
+  int ret = acquire(role, assets);
+  if (ret != 0) {
+    return ret;
+  }
+  if (runs > 0) {
+    Timer t("warmup: " + role);
+    warmup(*assets, runs);
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _pinned[role] = assets;
+  return 0;
+}
+
+// 读取模型到内存: 旧版已解密的明文文件直接读取, 否则把加密文件解密到内存,
+// 不再写出明文
+int RoleRegistry::readModel(const std::string &dir, const std::string &name,
+                            const std::map<std::string, std::string> &names,
+                            std::vector<char> &buf) {
+  fs::path plain = fs::path(dir) / names.at(name);
+  if (fs::exists(plain)) {
+    std::ifstream in(plain, std::ios::binary);
+    buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return buf.empty() ? -3 : 0;
+  }
+  fs::path file = fs::path(dir) / name;
+  if (!fs::exists(file)) {
+    PLOGI << "cant find " << file.string();
+    return -1;
+  }
+  int ret = gaes_decrypt(file.string(), buf);
+  if (ret != 0) {
+    PLOGE << "decrypt " << file.string() << " failed:" << ret;
+  }
+  return ret;
+}
+
+// 拼错的精度名会退回ncnn默认, 打日志免得配置看似生效
+static int parsePrec(const char *key, const std::string &name) {
+  if (!ncnnprec_known(name.c_str())) {
+    PLOGE << "unknown " << key << ":" << name << ", use ncnn default";
+  }
+  return ncnnprec_parse(name.c_str());
+}
+
+// conf.json中munet的ncnn精度
+static NcnnPrec munetPrec() {
+  auto conf = config::get();
+  NcnnPrec prec;
+  prec.storage = parsePrec("munetStorage", conf->munetStorage);
+  prec.arith = parsePrec("munetArith", conf->munetArith);
+  prec.flat = conf->munetFlat ? 1 : 0;
+  return prec;
+}
+
+AiOpts ortOptions() {
+  auto conf = config::get();
+  AiOpts opts;
+  opts.graphopt = conf->ortGraphOpt;
+  opts.intrathreads = conf->ortIntraThreads;
+  opts.interthreads = conf->ortInterThreads;
+  opts.memarena = conf->ortMemArena;
+  opts.mempattern = conf->ortMemPattern;
+  opts.cachedir = conf->ortCacheDir;
+  return opts;
+}
+
+// 只读映射模型: 明文文件直接映射; 加密文件解密一次写到/dev/shm, 由源文件路径,
+// 大小和修改时间命名, 同机其他进程直接映射同一份文件, 省去重复解密
+int RoleRegistry::mapModel(const std::string &dir, const std::string &name,
+                           const std::map<std::string, std::string> &names,
+                           std::shared_ptr<JMap> &map) {
+  map = std::make_shared<JMap>();
+  fs::path plain = fs::path(dir) / names.at(name);
+  if (fs::exists(plain)) {
+    return map->open(plain.string().c_str());
+  }
+  if (config::get()->shmWeights == false) {
+    return -1;
+  }
+  fs::path file = fs::path(dir) / name;
+  std::error_code ec;
+  auto size = fs::file_size(file, ec);
+  if (ec) {
+    PLOGI << "cant find " << file.string();
+    return -1;
+  }
+  auto mtime = fs::last_write_time(file, ec).time_since_epoch().count();
+  char key[64];
+  snprintf(key, sizeof(key), "gjdh_%016zx",
+           std::hash<std::string>()(file.string() + ":" + std::to_string(size) + ":" +
+                                    std::to_string(mtime)));
+  fs::path shm = fs::path("/dev/shm") / key;
+  // /dev/shm人人可写, 只认本用户publish出的0600文件, 否则可能映射到别人放的权重
+  int ret = map->open(shm.string().c_str(), 1);
+  if (ret == 0) {
+    PLOGI << "map shared " << file.string() << " from " << shm.string();
+    return 0;
+  }
+  if (ret == -5) {
+    PLOGE << "not mapping " << shm.string() << ": not a private file of this user";
+    return ret;
+  }
+  std::vector<char> buf;
+  ret = readModel(dir, name, names, buf);
+  if (ret != 0) {
+    return ret;
+  }
+  ret = JMap::publish(shm.string().c_str(), buf.data(), buf.size());
+  if (ret != 0) {
+    PLOGE << "publish " << shm.string() << " failed:" << ret;
+    return ret;
+  }
+  return map->open(shm.string().c_str(), 1);
+}
+
+std::shared_ptr<Wenet> RoleRegistry::wenet(const std::string &dir) {
+  std::promise<std::shared_ptr<Wenet>> promise;
+  std::shared_future<std::shared_ptr<Wenet>> flight;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (auto net = _wenets[dir].lock()) {
+      return net;
+    }
+    auto it = _wenetLoads.find(dir);
+    if (it != _wenetLoads.end()) {
+      flight = it->second;
+    } else {
+      _wenetLoads[dir] = promise.get_future().share();
+    }
+  }
+  if (flight.valid()) {
+    return flight.get();
+  }
+
+  std::shared_ptr<Wenet> net;
+  try {
+    std::vector<char> buf;
+    if (readModel(dir, "wenet.o", _baseMD5Map, buf) == 0) {
+      Timer t("wenet init: " + dir);
+      net = std::make_shared<Wenet>(buf.data(), buf.size(), ortOptions());
+    }
+  } catch (const std::exception &e) {
+    PLOGE << "wenet init failed: " << dir << " " << e.what();
+    net = nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (net) {
+      _wenets[dir] = net;
+    }
+    _wenetLoads.erase(dir);
+  }
+  promise.set_value(net);
+  return net;
+}
+
+// 一次遍历目录, 返回其中 "<序号>.sij" 的序号
+static std::set<int> scanFrames(const fs::path &dir) {
+  std::set<int> frames;
+  std::error_code ec;
+  for (const auto &entry : fs::directory_iterator(dir, ec)) {
+    const fs::path &file = entry.path();
+    if (file.extension() != ".sij") {
+      continue;
+    }
+    const std::string stem = file.stem().string();
+    if (stem.empty() || stem.find_first_not_of("0123456789") != std::string::npos) {
+      continue;
+    }
+    // 超长的数字名超出int, 跳过而不是抛异常
+    errno = 0;
+    long index = std::strtol(stem.c_str(), nullptr, 10);
+    if (errno == ERANGE || index > INT_MAX) {
+      continue;
+    }
+    frames.insert((int)index);
+  }
+  return frames;
+}
+
+int RoleRegistry::load(RoleAssets &assets, const std::shared_ptr<RoleInstall> &live) {
+  const std::string basePath = "/app/";
+  std::string baseDir = basePath + "gj_dh_res";
+  std::string modelDir = basePath + "roles/" + assets.role;
+  ModelInfo &info = assets.info;
+
+  // 安装中的目录在完成时会改名, 加载期间不让它动; 已装完的按普通角色加载
+  std::shared_lock<std::shared_mutex> installing;
+  if (live) {
+    installing = live->hold();
+    if (!live->finished() && live->livePack()) {
+      modelDir = live->dir();
+      assets.install = live;
+    }
+  }
+
+  // 证书由curl按路径读取, 仍解密成文件; 模型和配置只在内存中解密
+  fs::path cacert = fs::path(baseDir) / _baseMD5Map["cacert.p"];
+  if (fs::exists(cacert) == false) {
+    fs::path newFile = fs::path(baseDir) / "cacert.p";
+    PLOGI << "convert " << newFile.string() << " to " << cacert.string();
+    if (!fs::exists(newFile)) {
+      PLOGI << "cant find " << newFile.string();
+      return -1;
+    }
+    int ret = mainenc(0, const_cast<char *>(newFile.string().c_str()),
+                      const_cast<char *>(cacert.string().c_str()));
+    PLOGI << "convert result:" << ret;
+  }
+
+  // 模型解密和创建与下面的帧表构建并行进行
+  auto munet = std::async(std::launch::async, [this, &assets, baseDir, modelDir]() {
+    // munetInt8时优先用munetquant生成的int8模型, 角色没有时仍用fp32
+    std::string bin = "dh_model.b";
+    std::string prm = "dh_model.p";
+    auto has = [this, &modelDir](const std::string &name) {
+      return fs::exists(fs::path(modelDir) / _modelMD5Map.at(name)) ||
+             fs::exists(fs::path(modelDir) / name);
+    };
+    if (config::get()->munetInt8 && has("dh_model_int8.b") && has("dh_model_int8.p")) {
+      bin = "dh_model_int8.b";
+      prm = "dh_model_int8.p";
+      PLOGI << "munet int8: " << modelDir;
+    }
+    // 优先只读映射权重和weight掩码, 文件页多进程共享, 重排后的卷积权重仍是私有的
+    std::shared_ptr<JMap> binmap;
+    std::shared_ptr<JMap> mskmap;
+    std::vector<char> param;
+    if (mapModel(modelDir, bin, _modelMD5Map, binmap) == 0 &&
+        (mapModel(modelDir, "weight_168u.b", _modelMD5Map, mskmap) == 0 ||
+         mapModel(baseDir, "weight_168u.b", _baseMD5Map, mskmap) == 0) &&
+        readModel(modelDir, prm, _modelMD5Map, param) == 0) {
+      Timer t("munet init mapped: " + assets.role);
+      auto model = std::make_shared<MunetModel>(binmap, std::move(param), mskmap, munetPrec());
+      if (model->ready()) {
+        assets.munet = model;
+        return 0;
+      }
+      PLOGE << "munet init from mapped weights failed: " << modelDir;
+    }
+    std::vector<char> unetbin;
+    std::vector<char> unetparam;
+    std::vector<char> unetmsk;
+    if (readModel(modelDir, bin, _modelMD5Map, unetbin) != 0 ||
+        readModel(modelDir, prm, _modelMD5Map, unetparam) != 0) {
+      return -1;
+    }
+    if (readModel(modelDir, "weight_168u.b", _modelMD5Map, unetmsk) == 0) {
+      PLOGI << "使用模型自带的weight:" << modelDir;
+    } else if (readModel(baseDir, "weight_168u.b", _baseMD5Map, unetmsk) != 0) {
+      return -1;
+    }
+    Timer t("munet init: " + assets.role);
+    assets.munet = std::make_shared<MunetModel>(std::move(unetbin), std::move(unetparam),
+                                                 std::move(unetmsk), munetPrec());
+    return assets.munet->ready() ? 0 : -2;
+  });
+  auto wenetTask = std::async(std::launch::async, [this, baseDir]() { return wenet(baseDir); });
+  // 提前返回时也要等模型任务结束, 它们引用了assets
+  auto waitModels = [&]() {
+    int ret = munet.get();
+    assets.wenet = wenetTask.get();
+    if (ret == 0 && !assets.wenet) {
+      ret = -1;
+    }
+    return ret;
+  };
+
+  std::vector<char> bboxBuf;
+  std::vector<char> configBuf;
+  if (readModel(modelDir, "bbox.j", _modelMD5Map, bboxBuf) != 0 ||
+      readModel(modelDir, "config.j", _modelMD5Map, configBuf) != 0) {
+    waitModels();
+    return -1;
+  }
+  json boxJson = json::parse(bboxBuf.begin(), bboxBuf.end());
+  json configJson = json::parse(configBuf.begin(), configBuf.end());
+
+  info._hasMask = configJson.value("need_png", 0) == 0 &&
+                  fs::exists(fs::path(modelDir) / "raw_jpgs") &&
+                  fs::exists(fs::path(modelDir) / "raw_sg") &&
+                  fs::exists(fs::path(modelDir) / "pha");
+
+  fs::path packFile = fs::path(modelDir) / "frames.gpk";
+  if (assets.install) {
+    auto pack = std::make_unique<RolePack>();
+    int ret = pack->openlive(assets.install->livePack());
+    if (ret != 0) {
+      PLOGE << "open live role pack failed:" << packFile << " ret:" << ret;
+      waitModels();
+      return -3;
+    }
+    assets.pack = std::move(pack);
+  } else if (fs::exists(packFile)) {
+    auto pack = std::make_unique<RolePack>();
+    int ret = pack->open(packFile.string().c_str());
+    if (ret == 0) {
+      assets.pack = std::move(pack);
+    } else {
+      PLOGE << "open role pack failed:" << packFile << " ret:" << ret;
+    }
+  }
+
+  if (assets.pack) {
+    info._hasMask = configJson.value("need_png", 0) == 0 && assets.pack->hasmask();
+    PLOGI << "role pack frames:" << assets.pack->frames();
+    for (int i = 0; i < assets.pack->frames(); ++i) {
+      Frame frame;
+      frame.index = i + 1;
+      const int *box = assets.pack->box(i);
+      frame.rect[0] = box[0];
+      frame.rect[1] = box[1];
+      frame.rect[2] = box[2];
+      frame.rect[3] = box[3];
+      info._frames.push_back(frame);
+    }
+  }
+
+  // 安装中的pack还在写, 装完后下次加载再用
+  int roleFaces = config::get()->roleFaces;
+  if (assets.pack && !assets.install && roleFaces > 0) {
+    fs::path faceFile = fs::path(modelDir) / "frames.gfc";
+    auto faces = std::make_unique<RoleFaces>();
+    int ret = faces->open(faceFile.string().c_str(), packFile.string().c_str());
+    if (ret != 0 && roleFaces > 1) {
+      Timer t("compile faces: " + assets.role);
+      ret = roleface_compile(assets.pack.get(), packFile.string().c_str(),
+                             faceFile.string().c_str());
+      PLOGI << "compile faces:" << faceFile << " frames:" << ret;
+      ret = ret < 0 ? ret : faces->open(faceFile.string().c_str(), packFile.string().c_str());
+    }
+    if (ret == 0) {
+      PLOGI << "role faces:" << faces->frames();
+      assets.faces = std::move(faces);
+    } else {
+      PLOGI << "no role faces:" << faceFile << " ret:" << ret;
+    }
+  }
+
+  PLOGI << "hasMask:" << info._hasMask;
+  std::set<int> raws;
+  std::set<int> masks;
+  std::set<int> sgs;
+  if (!assets.pack) {
+    Timer t("scan frames: " + assets.role);
+    raws = scanFrames(fs::path(modelDir) / "raw_jpgs");
+    if (info._hasMask) {
+      masks = scanFrames(fs::path(modelDir) / "pha");
+      sgs = scanFrames(fs::path(modelDir) / "raw_sg");
+    }
+  }
+  for (int i = 1; !assets.pack && raws.count(i); ++i) {
+    auto rawPath = fs::path(modelDir) / "raw_jpgs" / (std::to_string(i) + ".sij");
+    auto maskPath = fs::path(modelDir) / "pha" / (std::to_string(i) + ".sij");
+    auto sgPath = fs::path(modelDir) / "raw_sg" / (std::to_string(i) + ".sij");
+    Frame frame;
+    frame.index = i;
+    frame._rawPath = rawPath.string();
+    if (masks.count(i)) {
+      frame._maskPath = maskPath.string();
+    }
+    if (sgs.count(i)) {
+      frame._sgPath = sgPath.string();
+    }
+    if (boxJson.count(std::to_string(i))) {
+      frame.rect[0] = boxJson[std::to_string(i)][0];
+      frame.rect[1] = boxJson[std::to_string(i)][2];
+      frame.rect[2] = boxJson[std::to_string(i)][1];
+      frame.rect[3] = boxJson[std::to_string(i)][3];
+    }
+    info._frames.push_back(frame);
+  }
+  if (info._frames.size() == 0) {
+    waitModels();
+    return -2;
+  }
+
+  info._width = configJson.value("width", 0);
+  info._height = configJson.value("height", 0);
+
+  auto conf = config::get();
+  if (conf->frameCacheMB > 0) {
+    assets.cache = std::make_unique<MFrameCache>((uint64_t)conf->frameCacheMB << 20);
+    // 安装中的角色帧还没到齐, 边渲染边缓存
+    if (conf->frameCachePreload && !assets.install) {
+      Timer t("frame cache preload");
+      // 按帧分段并行解码, 每段遇到错误或预算用完就停止
+      size_t parts = std::max(1u, std::thread::hardware_concurrency());
+      size_t count = info._frames.size();
+      std::vector<std::future<void>> fills;
+      for (size_t p = 0; p < parts && p < count; ++p) {
+        fills.push_back(std::async(std::launch::async, [&assets, &info, p, parts, count]() {
+          for (size_t k = p; k < count; k += parts) {
+            const Frame &frame = info._frames[k];
+            int ret = 0;
+            if (assets.pack) {
+              ret = assets.cache->fill(assets.pack.get(), frame.index - 1, kRenderPlanes);
+            } else {
+              ret = assets.cache->fill(frame._rawPath);
+              if (ret == 0) ret = assets.cache->fill(frame._sgPath);
+            }
+            if (ret != 0) {
+              PLOGI << "frame cache preload stop at:" << frame.index << " ret:" << ret;
+              break;
+            }
+          }
+        }));
+      }
+      for (auto &f : fills) {
+        f.get();
+      }
+    }
+    PLOGI << "frame cache budget:" << assets.cache->budget()
+          << " used:" << assets.cache->used();
+  }
+
+  if (conf->idleCacheMB > 0) {
+    assets.idle = std::make_unique<IdlePayloadCache>((uint64_t)conf->idleCacheMB << 20);
+  }
+
+  // 模型权重按角色共享, 每个会话只创建自己的extractor
+  int ret = waitModels();
+  if (ret != 0) {
+    return ret;
+  }
+
+  // 会话级配置, 模型已在上面创建, 不再交给GDigit::config
+  json ncnnConfig;
+  ncnnConfig["action"] = 1;
+  ncnnConfig["videowidth"] = info._width;
+  ncnnConfig["videoheight"] = info._height;
+  ncnnConfig["timeoutms"] = 5000;
+  ncnnConfig["cacertfn"] = fs::path(baseDir) / "cp";
+  // 共享的munet已按同样的精度创建, GDigit自己加载的模型(alpha等)照此设置
+  ncnnConfig["unetstorage"] = conf->munetStorage;
+  ncnnConfig["unetarith"] = conf->munetArith;
+  ncnnConfig["unetflat"] = conf->munetFlat ? 1 : 0;
+  ncnnConfig["alphastorage"] = conf->alphaStorage;
+  ncnnConfig["alphaarith"] = conf->alphaArith;
+  ncnnConfig["alphaflat"] = conf->alphaFlat ? 1 : 0;
+  PLOGI << "ncnnConfig:" << ncnnConfig.dump();
+  info._ncnnConfig = ncnnConfig.dump();
+
+  return 0;
+}
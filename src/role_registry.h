@@ -0,0 +1,87 @@
+/*************************************************************************
+    > File Name: role_registry.h
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月11日 星期二 22时46分16秒
+ ************************************************************************/
+#pragma once
+#include <digit/GDigit.h>
+#include <future>
+#include <map>
+#include <memory>
+#include <model_info.h>
+#include <mutex>
+#include <role_install.h>
+#include <string>
+#include <vector>
+
+// 输出只用合成后的彩色帧, pha掩码不解码, 不预读也不预加载
+static const int kRenderPlanes = GPK_BIT(GPK_RAW) | GPK_BIT(GPK_FG);
+
+// conf.json中的onnxruntime选项, wenet和基准测试共用
+AiOpts ortOptions();
+
+// 空闲帧最终发送的RGBA数据, 按帧号缓存, 超出预算后不再加入
+class IdlePayloadCache {
+public:
+  typedef std::shared_ptr<const std::vector<uint8_t>> Body;
+  explicit IdlePayloadCache(uint64_t budget) : _budget(budget) {}
+  Body get(int frame);
+  // 返回已缓存的数据(若其他会话先放入)或传入的body
+  Body put(int frame, const Body &body);
+
+private:
+  std::mutex _mutex;
+  uint64_t _budget = 0;
+  uint64_t _used = 0;
+  std::map<int, Body> _bodies;
+};
+
+// 同一角色的只读资源, 由该角色的所有会话共享;
+// 会话自己的状态(GDigit, 特征缓存, extractor)不在这里
+struct RoleAssets {
+  std::string role;
+  ModelInfo info;
+  std::unique_ptr<RolePack> pack;
+  // pack各帧预先裁剪缩放好的人脸, 没有时为空
+  std::unique_ptr<RoleFaces> faces;
+  std::unique_ptr<MFrameCache> cache;
+  std::unique_ptr<IdlePayloadCache> idle;
+  // 只读的网络和blend掩码, 每个会话用它建自己的Mobunet
+  std::shared_ptr<MunetModel> munet;
+  std::shared_ptr<Wenet> wenet;
+  // 用正在安装的角色启动时持有安装, pack读的是它的写端
+  std::shared_ptr<RoleInstall> install;
+};
+
+// 进程内按角色名引用计数的资源表, 最后一个会话释放后资源随之销毁
+class RoleRegistry {
+public:
+  static RoleRegistry *get();
+  // live为仍在安装的角色, 此时从安装目录和写入中的pack加载
+  int acquire(const std::string &role, std::shared_ptr<RoleAssets> &assets,
+              const std::shared_ptr<RoleInstall> &live = nullptr);
+  // 加载并常驻, 先做runs次空推理让ncnn/onnxruntime完成首次运行的准备
+  int preload(const std::string &role, int runs);
+  size_t size();
+
+private:
+  RoleRegistry();
+  int load(RoleAssets &assets, const std::shared_ptr<RoleInstall> &live);
+  int readModel(const std::string &dir, const std::string &name,
+                const std::map<std::string, std::string> &names, std::vector<char> &buf);
+  int mapModel(const std::string &dir, const std::string &name,
+               const std::map<std::string, std::string> &names, std::shared_ptr<JMap> &map);
+  std::shared_ptr<Wenet> wenet(const std::string &dir);
+
+  std::map<std::string, std::string> _baseMD5Map;
+  std::map<std::string, std::string> _modelMD5Map;
+
+  std::mutex _mutex;
+  std::map<std::string, std::weak_ptr<RoleAssets>> _roles;
+  std::map<std::string, std::shared_ptr<RoleAssets>> _pinned;
+  std::map<std::string, std::shared_ptr<std::mutex>> _loading;
+  std::map<std::string, std::weak_ptr<Wenet>> _wenets;
+  // 正在构建的wenet, 同一目录只建一次, 解密和建会话都不持有_mutex
+  std::map<std::string, std::shared_future<std::shared_ptr<Wenet>>> _wenetLoads;
+};
@@ -9,6 +9,8 @@
 #include <future>
 #include <getopt.hpp>
 #include <iostream>
+#include <jarena.h>
+#include <munetservice.h>
 #include <map>
 #include <vector>
 #include <cstdlib> // for std::getenv
@@ -60,7 +62,7 @@ struct WorkFLow {
         last_active_ts = getCurrentTimeMs();
     }
 
-    int init(std::function<void(std::vector<uint8_t> &data)> imgHdl,
+    int init(ImgHdl imgHdl,
              std::function<void(const std::string &msg)> msgHdl,
              const std::string &role = "SiYao") {
         touch();
@@ -234,11 +236,18 @@ public:
 
 ConnectionManager connectionManager;
 
-void onImg(server *s, websocketpp::connection_hdl hdl,
-           std::vector<uint8_t> &buf) {
+void onImg(server *s, websocketpp::connection_hdl hdl, const WireFrame &frame) {
     try {
         if (hdl.lock()) {
-            s->send(hdl, buf.data(), buf.size(), websocketpp::frame::opcode::binary);
+            // head与body直接写入同一条消息, 共享的body不再先拼接成一块
+            size_t size = frame.head.size() + (frame.body ? frame.body->size() : 0);
+            auto msg = websocketpp::lib::make_shared<websocketpp::config::asio::message_type>(
+                nullptr, websocketpp::frame::opcode::binary, size);
+            msg->append_payload(frame.head.data(), frame.head.size());
+            if (frame.body) {
+                msg->append_payload(frame.body->data(), frame.body->size());
+            }
+            s->send(hdl, msg);
         }
     } catch (...) {
         PLOGE << "send img failed";
@@ -350,6 +359,7 @@ int main(int argc, char* argv[]) {
         if (root.count("lmPrompt")) {
             config->lmPrompt = root["lmPrompt"];
         }
+        config->load(root);
     }
 
     const char* groq_key_env = std::getenv("GROQ_API_KEY");
@@ -373,6 +383,11 @@ int main(int argc, char* argv[]) {
         PLOGE << "config invalid:" << conf;
         return 1;
     }
+    // arena要在任何会话分配帧和特征缓冲之前建好
+    JArena::get()->init((uint64_t)config->arenaMB << 20, config->arenaHugePages);
+    MunetService::get()->init(config->inferWorkers, config->inferWindowUs, config->inferMaxBatch,
+                              config->inferDeadlineMs);
+    EdgeRender::preload(config->preloadRoles, config->warmupRuns);
 
     std::string IP = getPublicIP();
     PLOGI << "PublicIP:" << IP;
@@ -382,6 +397,10 @@ int main(int argc, char* argv[]) {
     std::system(cmd.c_str());
     svr.set_mount_point("/video", "/app/video");
     svr.set_mount_point("/audio", "/app/audio");
+    svr.Get("/stats", [](const httplib::Request &req, httplib::Response &res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        res.set_content(EdgeRender::stats(), "application/json");
+    });
 
     std::thread httpth([&svr] { svr.listen("0.0.0.0", 8080); });
     PLOGD << "http server start at 8080";
@@ -0,0 +1,217 @@
+/*************************************************************************
+    > File Name: zip_stream.cpp
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月16日 星期日 15时08分21秒
+ ************************************************************************/
+
+#include "zip_stream.h"
+#include <algorithm>
+#include <clog.h>
+#include <cstring>
+#include <limits>
+
+static const uint32_t kLocalSig = 0x04034b50;
+static const uint32_t kCentralSig = 0x02014b50;
+static const uint32_t kEndSig = 0x06054b50;
+static const uint32_t kEnd64Sig = 0x06064b50;
+static const uint32_t kDescSig = 0x08074b50;
+static const uint64_t kUnknown = std::numeric_limits<uint64_t>::max();
+
+static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t le32(const uint8_t *p) { return le16(p) | ((uint32_t)le16(p + 2) << 16); }
+static uint64_t le64(const uint8_t *p) { return le32(p) | ((uint64_t)le32(p + 4) << 32); }
+
+ZipStream::ZipStream() : _out(256 * 1024) { memset(&_zs, 0, sizeof(_zs)); }
+
+ZipStream::~ZipStream() {
+  if (_inflating) {
+    inflateEnd(&_zs);
+  }
+}
+
+int ZipStream::feed(const char *buf, size_t size) {
+  if (_state == FAILED) {
+    return -1;
+  }
+  std::vector<uint8_t> joined;
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(buf);
+  if (!_pending.empty()) {
+    // 上次剩下不足一个头部的数据, 和这次的拼在一起
+    joined.swap(_pending);
+    joined.insert(joined.end(), in, in + size);
+    in = joined.data();
+    size = joined.size();
+  }
+
+  size_t pos = 0;
+  while (pos < size && _state != DONE) {
+    int ret = 0;
+    size_t used = 0;
+    if (_state == DATA) {
+      ret = data(in + pos, size - pos, used);
+    } else if (_state == HEADER) {
+      ret = header(in + pos, size - pos);
+      if (ret == 0) {
+        _pending.assign(in + pos, in + size);
+        return 0;
+      }
+      used = ret > 0 ? ret : 0;
+    } else if (_state == DESCRIPTOR) {
+      size_t avail = size - pos;
+      if (avail < 4) {
+        _pending.assign(in + pos, in + size);
+        return 0;
+      }
+      size_t need = (le32(in + pos) == kDescSig ? 4 : 0) + 4 + (_zip64 ? 16 : 8);
+      if (avail < need) {
+        _pending.assign(in + pos, in + size);
+        return 0;
+      }
+      used = need;
+      _state = HEADER;
+    }
+    if (ret < 0) {
+      PLOGE << "zip stream error:" << ret;
+      _state = FAILED;
+      return ret;
+    }
+    pos += used;
+  }
+  return 0;
+}
+
+// 解析local file header, 返回消耗的字节数, 0为数据不够
+int ZipStream::header(const uint8_t *p, size_t avail) {
+  if (avail < 4) {
+    return 0;
+  }
+  uint32_t sig = le32(p);
+  if (sig == kCentralSig || sig == kEndSig || sig == kEnd64Sig) {
+    // 中央目录只是重复条目信息, 不再需要
+    _state = DONE;
+    return avail;
+  }
+  if (sig != kLocalSig) {
+    return -2;
+  }
+  if (avail < 30) {
+    return 0;
+  }
+  _flags = le16(p + 6);
+  _method = le16(p + 8);
+  uint64_t csize = le32(p + 18);
+  uint64_t usize = le32(p + 22);
+  size_t nameLen = le16(p + 26);
+  size_t extraLen = le16(p + 28);
+  if (avail < 30 + nameLen + extraLen) {
+    return 0;
+  }
+  std::string name(reinterpret_cast<const char *>(p + 30), nameLen);
+
+  _zip64 = false;
+  const uint8_t *extra = p + 30 + nameLen;
+  for (size_t k = 0; k + 4 <= extraLen;) {
+    uint16_t id = le16(extra + k);
+    uint16_t len = le16(extra + k + 2);
+    if (k + 4 + len > extraLen) {
+      return -9; // 扩展字段记录超出扩展区
+    }
+    if (id == 0x0001) {
+      _zip64 = true;
+      const uint8_t *v = extra + k + 4;
+      if (usize == 0xffffffff && len >= 8) {
+        usize = le64(v);
+        v += 8;
+        len -= 8;
+      }
+      if (csize == 0xffffffff && len >= 8) {
+        csize = le64(v);
+      }
+    }
+    k += 4 + le16(extra + k + 2);
+  }
+
+  if (_flags & 0x1) {
+    return -3; // 加密条目
+  }
+  if (_method != 0 && _method != 8) {
+    return -4;
+  }
+  if (_method == 0 && (_flags & 0x8)) {
+    return -5; // stored且大小未知, 无法确定数据结尾
+  }
+  _remain = (_flags & 0x8) ? kUnknown : csize;
+  if (_method == 8) {
+    int ret = _inflating ? inflateReset(&_zs) : inflateInit2(&_zs, -MAX_WBITS);
+    if (ret != Z_OK) {
+      return -7;
+    }
+    _inflating = true;
+  }
+  if (onBegin && onBegin(name) != 0) {
+    return -6;
+  }
+  _state = DATA;
+  if (_method == 0 && _remain == 0) {
+    int ret = endEntry();
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  return 30 + nameLen + extraLen;
+}
+
+int ZipStream::data(const uint8_t *in, size_t size, size_t &used) {
+  if (_method == 0) {
+    used = std::min<uint64_t>(size, _remain);
+    if (onData && onData(reinterpret_cast<const char *>(in), used) != 0) {
+      return -6;
+    }
+    _remain -= used;
+    return _remain == 0 ? endEntry() : 0;
+  }
+
+  size_t give = std::min<uint64_t>({size, _remain, (uint64_t)std::numeric_limits<uInt>::max()});
+  _zs.next_in = const_cast<Bytef *>(in);
+  _zs.avail_in = give;
+  int ret = Z_OK;
+  while (true) {
+    _zs.next_out = _out.data();
+    _zs.avail_out = _out.size();
+    ret = inflate(&_zs, Z_NO_FLUSH);
+    size_t produced = _out.size() - _zs.avail_out;
+    if (produced && onData &&
+        onData(reinterpret_cast<const char *>(_out.data()), produced) != 0) {
+      return -6;
+    }
+    if (ret == Z_STREAM_END || ret == Z_BUF_ERROR) {
+      break;
+    }
+    if (ret != Z_OK) {
+      return -7;
+    }
+    if (_zs.avail_in == 0 && _zs.avail_out != 0) {
+      break;
+    }
+  }
+  used = give - _zs.avail_in;
+  if (_remain != kUnknown) {
+    _remain -= used;
+  }
+  if (ret == Z_STREAM_END) {
+    return endEntry();
+  }
+  if (_remain == 0) {
+    return -8; // 压缩数据已读完但deflate流没有结束
+  }
+  return 0;
+}
+
+int ZipStream::endEntry() {
+  _state = (_flags & 0x8) ? DESCRIPTOR : HEADER;
+  if (onEnd && onEnd() != 0) {
+    return -6;
+  }
+  return 0;
+}
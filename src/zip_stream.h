@@ -0,0 +1,45 @@
+/*************************************************************************
+    > File Name: zip_stream.h
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月16日 星期日 15时08分21秒
+ ************************************************************************/
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// 边下载边解压zip: 按顺序解析local file header, 不依赖文件末尾的中央目录.
+// 支持stored/deflate, data descriptor和zip64大小; stored且大小放在descriptor里的条目无法流式解析
+class ZipStream {
+public:
+  // 返回非0中止解析
+  std::function<int(const std::string &name)> onBegin;
+  std::function<int(const char *data, size_t size)> onData;
+  std::function<int()> onEnd;
+
+  ZipStream();
+  ~ZipStream();
+  // 喂入下一段数据, 出错返回负数, 之后的数据都会被拒绝
+  int feed(const char *data, size_t size);
+  // 已读到中央目录, 所有条目都已解出
+  bool finished() const { return _state == DONE; }
+
+private:
+  enum State { HEADER, DATA, DESCRIPTOR, DONE, FAILED };
+  int header(const uint8_t *p, size_t avail);
+  int data(const uint8_t *in, size_t size, size_t &used);
+  int endEntry();
+
+  State _state = HEADER;
+  std::vector<uint8_t> _pending;
+  uint16_t _flags = 0;
+  uint16_t _method = 0;
+  uint64_t _remain = 0;
+  bool _zip64 = false;
+  z_stream _zs;
+  bool _inflating = false;
+  std::vector<uint8_t> _out;
+};
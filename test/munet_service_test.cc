@@ -0,0 +1,119 @@
+/*************************************************************************
+    > File Name: munet_service_test.cc
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月27日 星期四 14时02分51秒
+ ************************************************************************/
+
+// munet推理服务的批量和统计: 用内存里拼的单层1x1卷积模型代替真实munet,
+// 检查凑满maxbatch立即出批, 不满时等窗口到期, 已过截止时间的请求不等窗口并计入misses
+
+#include "aicommon.h"
+#include "munetservice.h"
+#include "test_util.h"
+#include <cstring>
+#include <future>
+#include <memory>
+#include <vector>
+
+// face(6通道)经1x1卷积出3通道output, audio只做输入; 与munet的输入输出名一致
+static std::shared_ptr<MunetModel> tinyModel() {
+  std::string text = "7767517\n"
+                     "3 3\n"
+                     "Input face 0 1 face\n"
+                     "Input audio 0 1 audio\n"
+                     "Convolution output 1 1 face output 0=3 1=1 5=0 6=18\n";
+  std::vector<char> param(text.begin(), text.end());
+  // 权重前4字节为0表示fp32原样存放
+  std::vector<float> weights(1 + 18, 0.0f);
+  for (int k = 1; k <= 18; ++k) {
+    weights[k] = k % 7 == 1 ? 1.0f : 0.0f;
+  }
+  std::vector<char> bin((const char *)weights.data(), (const char *)(weights.data() + weights.size()));
+  std::vector<char> msk(160 * 160, 0x80);
+  return std::make_shared<MunetModel>(bin, param, msk);
+}
+
+struct Frame {
+  JMat pic{160, 160, 3, 0, 1};
+  JMat msk{160, 160, 3, 0, 1};
+  JMat feat{MFCC_BNFCHUNK, 20, 1};
+};
+
+static uint64_t waitCount(const munetsvc_stat &st) {
+  uint64_t sum = 0;
+  for (int k = 0; k < MUNETSVC_WAITS; ++k) {
+    sum += st.waithist[k];
+  }
+  return sum;
+}
+
+int main() {
+  auto model = tinyModel();
+  CHECK(model->ready());
+  MunetService *service = MunetService::get();
+  Frame frame;
+  // 未启动时拒绝请求, 会话自己推理
+  CHECK(service->submit(model, &frame.pic, &frame.msk, &frame.feat).get() == -1);
+
+  // 窗口200ms, 截止1s
+  const int windowus = 200000;
+  CHECK(service->init(1, windowus, 4, 1000) == 0);
+  CHECK(service->running());
+  std::vector<Frame> frames(4);
+
+  // 凑满maxbatch不等窗口, 四个请求一批
+  std::vector<std::future<int>> futs;
+  int64_t t0 = MunetService::nowus();
+  for (auto &f : frames) {
+    futs.push_back(service->submit(model, &f.pic, &f.msk, &f.feat));
+  }
+  for (auto &fut : futs) {
+    CHECK(fut.get() == 0);
+  }
+  CHECK(MunetService::nowus() - t0 < windowus);
+  munetsvc_stat st;
+  service->stat(&st);
+  CHECK(st.workers == 1);
+  CHECK(st.requests == 4);
+  CHECK(st.batches == 1);
+  CHECK(st.batchhist[4] == 1);
+  CHECK(st.pending == 0);
+  CHECK(st.misses == 0);
+  CHECK(waitCount(st) == 4);
+
+  // 不满一批的两个请求等到窗口到期一起出批, 等待计入最后一档
+  futs.clear();
+  t0 = MunetService::nowus();
+  for (int k = 0; k < 2; ++k) {
+    futs.push_back(service->submit(model, &frames[k].pic, &frames[k].msk, &frames[k].feat));
+  }
+  for (auto &fut : futs) {
+    CHECK(fut.get() == 0);
+  }
+  CHECK(MunetService::nowus() - t0 >= windowus);
+  service->stat(&st);
+  CHECK(st.requests == 6);
+  CHECK(st.batches == 2);
+  CHECK(st.batchhist[2] == 1);
+  CHECK(st.waithist[MUNETSVC_WAITS - 1] == 2);
+  CHECK(st.misses == 0);
+
+  // 截止时间已过: 立即单独出批, 算一次miss
+  t0 = MunetService::nowus();
+  CHECK(service->submit(model, &frame.pic, &frame.msk, &frame.feat, t0 - 1).get() == 0);
+  CHECK(MunetService::nowus() - t0 < windowus);
+  service->stat(&st);
+  CHECK(st.requests == 7);
+  CHECK(st.batches == 3);
+  CHECK(st.batchhist[1] == 1);
+  CHECK(st.misses == 1);
+  CHECK(st.pending == 0);
+  CHECK(waitCount(st) == 7);
+
+  service->stop();
+  CHECK(!service->running());
+  CHECK(service->submit(model, &frame.pic, &frame.msk, &frame.feat).get() == -1);
+  printf("munet_service_test: %d failures\n", g_failures);
+  return g_failures;
+}
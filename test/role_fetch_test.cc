@@ -0,0 +1,211 @@
+/*************************************************************************
+    > File Name: role_fetch_test.cc
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月27日 星期四 10时24分18秒
+ ************************************************************************/
+
+// 单飞下载: 本地起一个慢速http服务, 多个线程同时ensure同一key, 检查只下载一次且都拿到结果;
+// 目录已存在时不等别的key的下载; 下载失败时所有等待者都拿到错误, 之后可以重试
+
+#include "role_fetch.h"
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// 每个连接只处理一个请求: 路径在_files中时按chunk字节一块, 每块间隔delayMs返回, 否则404
+class TestServer {
+public:
+  TestServer(int chunk, int delayMs) : _chunk(chunk), _delayMs(delayMs) {
+    _fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (_fd < 0 || bind(_fd, (sockaddr *)&addr, len) != 0 || listen(_fd, 16) != 0 ||
+        getsockname(_fd, (sockaddr *)&addr, &len) != 0) {
+      perror("test server");
+      exit(1);
+    }
+    _port = ntohs(addr.sin_port);
+    _thread = std::thread([this] { loop(); });
+  }
+
+  ~TestServer() {
+    shutdown(_fd, SHUT_RDWR);
+    close(_fd);
+    _thread.join();
+    for (auto &t : _conns) {
+      t.join();
+    }
+  }
+
+  void serve(const std::string &path, const std::string &body) { _files[path] = body; }
+  std::string url(const std::string &path) const {
+    return "http://127.0.0.1:" + std::to_string(_port) + path;
+  }
+  int requests(const std::string &path) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requests[path];
+  }
+
+private:
+  void loop() {
+    for (;;) {
+      int conn = accept(_fd, nullptr, nullptr);
+      if (conn < 0) {
+        return;
+      }
+      _conns.emplace_back([this, conn] { handle(conn); });
+    }
+  }
+
+  void handle(int conn) {
+    std::string req;
+    char buf[1024];
+    while (req.find("\r\n\r\n") == std::string::npos) {
+      ssize_t n = recv(conn, buf, sizeof(buf), 0);
+      if (n <= 0) {
+        close(conn);
+        return;
+      }
+      req.append(buf, n);
+    }
+    size_t start = req.find(' ') + 1;
+    std::string path = req.substr(start, req.find(' ', start) - start);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_requests[path];
+    }
+    auto it = _files.find(path);
+    if (it == _files.end()) {
+      sendAll(conn, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+      close(conn);
+      return;
+    }
+    const std::string &body = it->second;
+    sendAll(conn, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) +
+                      "\r\nConnection: close\r\n\r\n");
+    for (size_t pos = 0; pos < body.size(); pos += _chunk) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(_delayMs));
+      if (!sendAll(conn, body.substr(pos, _chunk))) {
+        break;
+      }
+    }
+    close(conn);
+  }
+
+  static bool sendAll(int conn, const std::string &data) {
+    for (size_t pos = 0; pos < data.size();) {
+      ssize_t n = send(conn, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      pos += n;
+    }
+    return true;
+  }
+
+  int _fd = -1;
+  int _port = 0;
+  int _chunk;
+  int _delayMs;
+  std::thread _thread;
+  std::vector<std::thread> _conns;
+  std::map<std::string, std::string> _files;
+  std::mutex _mutex;
+  std::map<std::string, int> _requests;
+};
+
+static const int kThreads = 8;
+
+// 同时到来的ensure并发调用, 返回各自的结果
+static std::vector<int> ensureAll(const std::string &key, const std::string &url,
+                                  const fs::path &dir) {
+  std::vector<int> rets(kThreads, 1);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&, i] { rets[i] = RoleFetcher::get()->ensure(key, url, dir.string(), "role"); });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  return rets;
+}
+
+static void testSingleFlight(TestServer &server, const fs::path &work) {
+  fs::path dir = work / "one";
+  for (int ret : ensureAll("one", server.url("/role.zip"), dir)) {
+    CHECK(ret == 0);
+  }
+  CHECK(server.requests("/role.zip") == 1);
+  CHECK(fs::exists(dir / "a.txt"));
+  CHECK(fs::exists(dir / "b.txt"));
+  CHECK(!fs::exists(dir.string() + ".extract"));
+
+  // 装好之后不再下载
+  CHECK(RoleFetcher::get()->ensure("one", server.url("/role.zip"), dir.string(), "role") == 0);
+  CHECK(server.requests("/role.zip") == 1);
+}
+
+static void testExisting(TestServer &server, const fs::path &work) {
+  // 另一个key的下载进行中, 已存在的目录直接返回
+  std::atomic<bool> slowDone(false);
+  int slowRet = 1;
+  std::thread slow([&] {
+    slowRet = RoleFetcher::get()->ensure("slow", server.url("/slow.zip"), (work / "slow").string(), "role");
+    slowDone = true;
+  });
+  while (server.requests("/slow.zip") == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(RoleFetcher::get()->ensure("one", server.url("/role.zip"), (work / "one").string(), "role") == 0);
+  CHECK(!slowDone);
+  slow.join();
+  CHECK(slowRet == 0);
+  CHECK(fs::exists(work / "slow" / "a.txt"));
+}
+
+static void testFailure(TestServer &server, const fs::path &work) {
+  fs::path dir = work / "missing";
+  for (int ret : ensureAll("missing", server.url("/missing.zip"), dir)) {
+    CHECK(ret != 0);
+  }
+  CHECK(server.requests("/missing.zip") == 1);
+  CHECK(!fs::exists(dir));
+  CHECK(!fs::exists(dir.string() + ".extract"));
+
+  // 失败不缓存, 再次ensure重新下载
+  CHECK(RoleFetcher::get()->ensure("missing", server.url("/missing.zip"), dir.string(), "role") != 0);
+  CHECK(server.requests("/missing.zip") == 2);
+}
+
+int main() {
+  // 本地服务不能走代理
+  for (const char *name : {"http_proxy", "HTTP_PROXY", "https_proxy", "HTTPS_PROXY", "all_proxy", "ALL_PROXY"}) {
+    unsetenv(name);
+  }
+  fs::path work = tempDir("role_fetch_test");
+  std::string zip = makeZip({{"role/a.txt", std::string(4096, 'a'), ""}, {"role/b.txt", "b", ""}});
+  {
+    // 每块间隔让并发的ensure都在下载结束前到达
+    TestServer server(512, 20);
+    server.serve("/role.zip", zip);
+    server.serve("/slow.zip", zip);
+    testSingleFlight(server, work);
+    testExisting(server, work);
+    testFailure(server, work);
+  }
+  fs::remove_all(work);
+  printf("role_fetch_test: %d failures\n", g_failures);
+  return g_failures;
+}
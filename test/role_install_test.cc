@@ -0,0 +1,152 @@
+/*************************************************************************
+    > File Name: role_install_test.cc
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月26日 星期三 20时10分32秒
+ ************************************************************************/
+
+// 流式安装: 本地拼出的zip按小块喂给RoleInstall(ZipStream), 检查正常角色能装出pack,
+// 以及来自网络的坏条目(目录穿越, 超大帧号, 坏bbox/config, 坏扩展字段)只让安装失败, 不抛异常
+
+#include "aesmain.h"
+#include "role_install.h"
+#include "test_util.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+// bbox.j/config.j在角色包里是加密的
+static std::string encrypt(const fs::path &dir, const std::string &plain) {
+  fs::path in = dir / "plain.tmp";
+  fs::path out = dir / "enc.tmp";
+  std::ofstream(in, std::ios::binary) << plain;
+  std::string src = in.string();
+  std::string dst = out.string();
+  if (mainenc(1, src.data(), dst.data()) != 0) {
+    fprintf(stderr, "encrypt failed\n");
+    exit(1);
+  }
+  std::ifstream enc(out, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(enc)), std::istreambuf_iterator<char>());
+  fs::remove(in);
+  fs::remove(out);
+  return data;
+}
+
+// 每次只喂step字节, 覆盖头部跨块的情况; 返回第一个错误
+static int install(RoleInstall &inst, const std::string &zip, size_t step) {
+  for (size_t pos = 0; pos < zip.size(); pos += step) {
+    int ret = inst.feed(zip.data() + pos, std::min(step, zip.size() - pos));
+    if (ret != 0) {
+      return ret;
+    }
+  }
+  return 0;
+}
+
+static void testGood(const fs::path &work) {
+  fs::path dir = work / "good";
+  fs::create_directories(dir);
+  std::string config = encrypt(work, R"({"need_png":1,"width":4,"height":4})");
+  std::string bbox = encrypt(work, R"({"1":[0,4,1,3],"2":[1,3,0,2]})");
+  std::string zip = makeZip({{"role/config.j", config, ""},
+                             {"role/bbox.j", bbox, ""},
+                             {"role/raw_jpgs/1.sij", "frame one", ""},
+                             {"role/raw_jpgs/2.sij", "frame two", ""},
+                             {"other/ignored.txt", "x", ""}});
+  RoleInstall inst(dir.string(), "role", 0);
+  CHECK(install(inst, zip, 7) == 0);
+  CHECK(inst.finish() == 0);
+  CHECK(fs::exists(dir / "config.j"));
+  CHECK(!fs::exists(dir / "ignored.txt"));
+
+  RolePack pack;
+  CHECK(pack.open((dir / "frames.gpk").string().c_str()) == 0);
+  CHECK(pack.frames() == 2);
+  const int *box = pack.box(0);
+  CHECK(box && box[0] == 0 && box[1] == 1 && box[2] == 4 && box[3] == 3);
+  const uint8_t *buf = nullptr;
+  uint32_t size = 0;
+  CHECK(pack.plane(1, GPK_RAW, &buf, &size) == 0);
+  CHECK(size == 9 && memcmp(buf, "frame two", 9) == 0);
+}
+
+static void testTraversal(const fs::path &work) {
+  const char *names[] = {"role/../evil.txt", "role/raw_jpgs/../../evil.txt", "role//tmp/evil.txt"};
+  for (const char *name : names) {
+    fs::path dir = work / "traversal";
+    fs::create_directories(dir);
+    RoleInstall inst(dir.string(), "role", 0);
+    CHECK(install(inst, makeZip({{name, "evil", ""}}), 5) < 0);
+    CHECK(!fs::exists(work / "evil.txt"));
+    CHECK(!fs::exists("/tmp/evil.txt"));
+    fs::remove_all(dir);
+  }
+}
+
+static void testHugeFrame(const fs::path &work) {
+  fs::path dir = work / "huge";
+  fs::create_directories(dir);
+  // int范围内但远超GPK_LIVEFRAMES, 不能按帧号分配索引表
+  RoleInstall inst(dir.string(), "role", 0);
+  CHECK(install(inst, makeZip({{"role/raw_jpgs/2000000000.sij", "x", ""}}), 64) < 0);
+
+  // 超出int的帧号不是帧, 当普通文件
+  fs::path other = work / "overflow";
+  fs::create_directories(other);
+  RoleInstall inst2(other.string(), "role", 0);
+  CHECK(install(inst2, makeZip({{"role/raw_jpgs/99999999999999999999.sij", "x", ""}}), 64) == 0);
+}
+
+static void testBadJson(const fs::path &work) {
+  // 每帧的框类型不对只跳过该帧的框
+  fs::path dir = work / "badbox";
+  fs::create_directories(dir);
+  std::string bbox = encrypt(work, R"({"1":"oops","2":[1,2],"3":[1,"a",2,3]})");
+  std::string config = encrypt(work, R"({"need_png":"yes","width":[4],"height":4})");
+  RoleInstall inst(dir.string(), "role", 0);
+  CHECK(install(inst, makeZip({{"role/raw_jpgs/1.sij", "a", ""},
+                               {"role/raw_jpgs/2.sij", "b", ""},
+                               {"role/raw_jpgs/3.sij", "c", ""},
+                               {"role/bbox.j", bbox, ""},
+                               {"role/config.j", config, ""}}),
+                11) == 0);
+  CHECK(inst.finish() == 0);
+  RolePack pack;
+  CHECK(pack.open((dir / "frames.gpk").string().c_str()) == 0);
+  for (int k = 0; k < pack.frames(); ++k) {
+    const int *box = pack.box(k);
+    CHECK(box && box[0] == 0 && box[1] == 0 && box[2] == 0 && box[3] == 0);
+  }
+
+  // 根不是对象的bbox让安装失败
+  fs::path dir2 = work / "badroot";
+  fs::create_directories(dir2);
+  RoleInstall inst2(dir2.string(), "role", 0);
+  CHECK(install(inst2, makeZip({{"role/bbox.j", encrypt(work, "[1,2,3]"), ""}}), 64) < 0);
+}
+
+static void testBadExtra(const fs::path &work) {
+  fs::path dir = work / "extra";
+  fs::create_directories(dir);
+  // zip64记录声明100字节, 扩展区只有4字节
+  std::string extra;
+  put16(extra, 0x0001);
+  put16(extra, 100);
+  RoleInstall inst(dir.string(), "role", 0);
+  CHECK(install(inst, makeZip({{"role/a.txt", "a", extra}}), 64) < 0);
+}
+
+int main() {
+  fs::path work = tempDir("role_install_test");
+  testGood(work);
+  testTraversal(work);
+  testHugeFrame(work);
+  testBadJson(work);
+  testBadExtra(work);
+  fs::remove_all(work);
+  printf("role_install_test: %d failures\n", g_failures);
+  return g_failures;
+}
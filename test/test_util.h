@@ -0,0 +1,73 @@
+/*************************************************************************
+    > File Name: test_util.h
+    > Author: 1216451203@qq.com
+    > Mail: 1216451203@qq.com
+    > Created Time: 2025年03月26日 星期三 20时10分32秒
+ ************************************************************************/
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// 测试只依赖本仓库已有的库: CHECK失败时打印位置并计数, main返回失败数, ctest按非0判失败
+static int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+  do {                                                                               \
+    if (!(cond)) {                                                                   \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);       \
+      ++g_failures;                                                                  \
+    }                                                                                \
+  } while (0)
+
+// /tmp下新建的空目录, 由调用者删除
+static std::filesystem::path tempDir(const std::string &name) {
+  std::string tmpl = "/tmp/" + name + "_XXXXXX";
+  if (!mkdtemp(tmpl.data())) {
+    perror("mkdtemp");
+    exit(1);
+  }
+  return tmpl;
+}
+
+static void put16(std::string &s, uint16_t v) {
+  s.push_back(v & 0xff);
+  s.push_back(v >> 8);
+}
+
+static void put32(std::string &s, uint32_t v) {
+  put16(s, v & 0xffff);
+  put16(s, v >> 16);
+}
+
+struct ZipEntry {
+  std::string name;
+  std::string data;
+  std::string extra;
+};
+
+// stored条目的local header加数据, 结尾只放end of central directory, ZipStream读到即结束
+static std::string makeZip(const std::vector<ZipEntry> &entries) {
+  std::string zip;
+  for (const auto &e : entries) {
+    put32(zip, 0x04034b50);
+    put16(zip, 20);
+    put16(zip, 0);
+    put16(zip, 0);
+    put16(zip, 0);
+    put16(zip, 0);
+    put32(zip, crc32(0, reinterpret_cast<const Bytef *>(e.data.data()), e.data.size()));
+    put32(zip, e.data.size());
+    put32(zip, e.data.size());
+    put16(zip, e.name.size());
+    put16(zip, e.extra.size());
+    zip += e.name + e.extra + e.data;
+  }
+  put32(zip, 0x06054b50);
+  zip.append(18, '\0');
+  return zip;
+}